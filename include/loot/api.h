@@ -103,9 +103,18 @@
  *  @file api.h
  *  @brief This file contains the API frontend.
  *
- *  @note The LOOT API is *not* thread safe. Thread safety is a goal, but one
- *        that has not yet been achieved. Bear this in mind if using it in a
- *        multi-threaded client.
+ *  @note The database access functions can be called on the same database
+ *        handle from multiple threads at once, and can also run while
+ *        another thread loads or evaluates the masterlist and userlist,
+ *        sorts plugins or applies a load order. Each query reads the
+ *        metadata lists as they were when the query started: changes are
+ *        swapped in whole once they are complete. Entries that
+ *        loot_eval_lists() left to be evaluated on lookup are evaluated
+ *        against the game's state when they are first looked up, which a
+ *        later sort or load order change may have altered, and each entry
+ *        keeps that first result until the lists are next evaluated. Calls
+ *        that change a database's state are serialised. A database handle
+ *        must not be destroyed while another thread is using it.
  *
  *  @section var_sec Variable Types
  *
@@ -125,11 +134,18 @@
  *  Data returned by a function lasts until a function is called which returns
  *  data of the same type (eg. a string is stored until the client calls
  *  another function which returns a string, an integer array lasts until
- *  another integer array is returned, etc.).
+ *  another integer array is returned, etc.). The data returned by the
+ *  database access functions, other than loot_get_tag_map(), and by
+ *  loot_get_masterlist_revision() is kept separately for each thread, so
+ *  only calls from the same thread replace it. A thread's data is kept
+ *  until the thread calls loot_release_thread_outputs(), even after the
+ *  thread has ended, so a thread that is done with a database should call
+ *  it. Otherwise, a later thread that is given the same thread ID may
+ *  be given its data.
  *
  *  All allocated memory is freed when loot_destroy_db() is called, except the
- *  string allocated by loot_get_error_message(), which must be freed by
- *  calling loot_cleanup().
+ *  strings allocated by loot_get_error_message(), which must be freed by
+ *  calling loot_cleanup() from each thread that encountered an error.
  */
 
 #ifndef __LOOT_API_H__
@@ -181,11 +197,31 @@ extern "C"
      *  @details Used to keep each game's data independent. Abstracts the
      *           definition of the API's internal state while still providing
      *           type safety across the library. Multiple handles can also be
-     *           made for each game, though it should be kept in mind that the
-     *           API is not thread-safe.
+     *           made for each game, and each handle can be queried from
+     *           multiple threads at once.
      */
     typedef struct _loot_db_int * loot_db;
 
+    /**
+     *  @brief A handle for a sort that is running in the background.
+     *  @details Created by loot_start_sort(), and used to cancel the sort,
+     *           wait for its result and free it.
+     */
+    typedef struct _loot_sort_job_int * loot_sort_job;
+
+    /**
+     *  @brief A function that is called with progress messages during a
+     *         background sort.
+     *  @details The function is called from the thread that the sort runs
+     *           in. `message` is only valid for the duration of the call, and
+     *           `userData` is the pointer that was given to
+     *           loot_start_sort(). The sort holds the database's locks
+     *           while it calls the function, so the function must not call
+     *           any function on the database being sorted, or wait for
+     *           another thread that does. It may call loot_cancel_sort().
+     */
+    typedef void (*loot_progress_callback)(const char * message, void * userData);
+
     /**
      *  @brief A structure that holds the type of a message and the message
      *      string itself.
@@ -204,6 +240,44 @@ extern "C"
         const char * message;
     } loot_message;
 
+    /**
+     *  @brief A structure that holds the Bash Tag suggestions, messages and
+     *      cleanliness of a plugin, as outputted by loot_get_plugins_info().
+     */
+    typedef struct {
+        /**
+         *  @var tagIds_added
+         *      The UIDs of the Bash Tags suggested for addition to the
+         *      plugin. `NULL` if no Bash Tag additions are suggested.
+         *  @var numTags_added
+         *      The size of the `tagIds_added` array.
+         *  @var tagIds_removed
+         *      The UIDs of the Bash Tags suggested for removal from the
+         *      plugin. `NULL` if no Bash Tag removals are suggested.
+         *  @var numTags_removed
+         *      The size of the `tagIds_removed` array.
+         *  @var userlistModified
+         *      `true` if the Bash Tag suggestions were modified by the data
+         *      in the userlist, `false` otherwise.
+         *  @var messages
+         *      The messages associated with the plugin. `NULL` if the plugin
+         *      has no messages associated with it.
+         *  @var numMessages
+         *      The size of the `messages` array.
+         *  @var needsCleaning
+         *      A plugin cleanliness code, as outputted by
+         *      loot_get_dirty_info().
+         */
+        unsigned int * tagIds_added;
+        size_t numTags_added;
+        unsigned int * tagIds_removed;
+        size_t numTags_removed;
+        bool userlistModified;
+        loot_message * messages;
+        size_t numMessages;
+        unsigned int needsCleaning;
+    } loot_plugin_info;
+
     /**********************************************************************//**
      *  @name Return Codes
      *  @brief Error codes signify an issue that caused a function to exit
@@ -226,6 +300,7 @@ extern "C"
     LOOT_API extern const unsigned int loot_error_git_error;  /**< An error occurred while performing a git operation (updating or getting the masterlist version). */
     LOOT_API extern const unsigned int loot_error_windows_error;  /**< An error occurred during a call to the Windows API. */
     LOOT_API extern const unsigned int loot_error_sorting_error;  /**< An error occurred while sorting plugins. */
+    LOOT_API extern const unsigned int loot_error_cancelled;  /**< The operation was cancelled before it finished. */
 
     /**
      *  @brief Matches the value of the highest-numbered return code.
@@ -299,10 +374,10 @@ extern "C"
     /**
      *  @brief Returns the message for the last error or warning encountered.
      *  @details Outputs a string giving the a message containing the details
-     *           of the last error or warning encountered by a function. Each
-     *           time this function is called, the memory for the previous
-     *           message is freed, so only one error message is available at
-     *           any one time.
+     *           of the last error or warning encountered by a function in the
+     *           calling thread. Each time an error occurs in the thread, the
+     *           memory for the previous message is freed, so only one error
+     *           message is available to each thread at any one time.
      *  @param message
      *      A pointer to the error details string outputted by the function.
      *  @returns A return code.
@@ -310,7 +385,8 @@ extern "C"
     LOOT_API unsigned int loot_get_error_message(const char ** const message);
 
     /**
-     *  @brief Frees the memory allocated to the last error details string.
+     *  @brief Frees the memory allocated to the calling thread's last error
+     *         details string.
      */
     LOOT_API void loot_cleanup();
 
@@ -412,7 +488,10 @@ extern "C"
     /**
      *  @brief Loads the masterlist and userlist from the paths specified.
      *  @details Can be called multiple times, each time replacing the
-     *           previously-loaded data.
+     *           previously-loaded data. Database handles that load the same
+     *           masterlist file with the same content share one copy of it.
+     *           This function only reads the given files: it doesn't write
+     *           any cache or other files.
      *  @param db
      *      The database the function acts on.
      *  @param masterlistPath
@@ -433,7 +512,11 @@ extern "C"
      *         entries.
      *  @details Repeated calls re-evaluate the metadata from scratch. This
      *           function affects the output of all the database access
-     *           functions.
+     *           functions. Entries for installed plugins are evaluated by
+     *           this function, and errors in their conditions are returned
+     *           from it. Entries for other plugins are evaluated when they
+     *           are first looked up, so a database access function can
+     *           return ::loot_error_condition_eval_fail for them.
      *  @param db
      *      The database the function acts on.
      *  @param language
@@ -452,7 +535,10 @@ extern "C"
      *  @brief Calculates a new load order for the game's installed plugins
      *         (including inactive plugins) and outputs the sorted order.
      *  @details Pulls metadata from the masterlist and userlist if they are
-     *           loaded, and reads the contents of each plugin. No changes are
+     *           loaded, and reads the contents of each plugin. Plugins read
+     *           by a previous sort are only read again if their size or
+     *           modification time has changed, or if
+     *           loot_invalidate_plugins() has been called. No changes are
      *           applied to the load order used by the game. This function does
      *           not load or evaluate the masterlist or userlist.
      *  @param db
@@ -468,6 +554,82 @@ extern "C"
                                             char *** const sortedPlugins,
                                             size_t * const numPlugins);
 
+    /**
+     *  @brief Starts calculating a new load order in a background thread.
+     *  @details The sort does the same work as loot_sort_plugins(), but this
+     *           function returns as soon as the sort has started. The sort
+     *           can be cancelled using loot_cancel_sort(), and its result is
+     *           obtained using loot_wait_for_sort(). The job must be freed
+     *           using loot_destroy_sort_job() before the database is
+     *           destroyed.
+     *  @param db
+     *      The database the function acts on.
+     *  @param progressCallback
+     *      A function that is called with a message as each stage of the
+     *      sort begins, or `NULL`.
+     *  @param userData
+     *      A pointer that is passed to `progressCallback`.
+     *  @param job
+     *      A pointer to the outputted job handle.
+     *  @returns A return code.
+     */
+    LOOT_API unsigned int loot_start_sort(loot_db db,
+                                          const loot_progress_callback progressCallback,
+                                          void * const userData,
+                                          loot_sort_job * const job);
+
+    /**
+     *  @brief Asks a background sort to stop.
+     *  @details The sort stops when it next checks for cancellation, which
+     *           it does between plugins while loading them and while adding
+     *           each edge to the plugin graph. Waiting for a cancelled sort
+     *           gives `loot_error_cancelled`, unless it had already finished.
+     *  @param job
+     *      The job to cancel.
+     *  @returns A return code.
+     */
+    LOOT_API unsigned int loot_cancel_sort(loot_sort_job job);
+
+    /**
+     *  @brief Waits for a background sort to finish and outputs its result.
+     *  @details Returns the code that loot_sort_plugins() would have
+     *           returned. The outputted array is valid until the job is
+     *           destroyed. A job can be waited for from more than one
+     *           thread at once.
+     *  @param job
+     *      The job to wait for.
+     *  @param sortedPlugins
+     *      A pointer to an array of plugin filenames in their sorted load
+     *      order.
+     *  @param numPlugins
+     *      A pointer to the size of the outputted array.
+     *  @returns A return code.
+     */
+    LOOT_API unsigned int loot_wait_for_sort(loot_sort_job job,
+                                             char *** const sortedPlugins,
+                                             size_t * const numPlugins);
+
+    /**
+     *  @brief Frees a background sort job.
+     *  @details If the sort is still running, it is cancelled and waited for
+     *           first.
+     *  @param job
+     *      The job to destroy.
+     */
+    LOOT_API void loot_destroy_sort_job(loot_sort_job job);
+
+    /**
+     *  @brief Makes the next sort read every plugin again.
+     *  @details Sorting only reads the plugins that have changed size or
+     *           modification time since they were last read. Call this if
+     *           plugins may have been changed in a way that doesn't alter
+     *           either of those.
+     *  @param db
+     *      The database the function acts on.
+     *  @returns A return code.
+     */
+    LOOT_API unsigned int loot_invalidate_plugins(loot_db db);
+
     /**
      *  @brief Applies the given load order.
      *  @param db
@@ -571,6 +733,11 @@ extern "C"
      *  @details This function must be called prior to calling
      *           loot_get_plugin_tags() to ensure that the latter can return
      *           the Tags using the correct array indicies.
+     *
+     *           The map is built when the masterlist and userlist are loaded,
+     *           and includes the Bash Tags of every entry, whatever their
+     *           conditions. It is sorted by tag name, and doesn't change
+     *           when the lists are evaluated.
      *  @param db
      *      The database the function acts on.
      *  @param tagMap
@@ -667,10 +834,58 @@ extern "C"
                                               const char * const plugin,
                                               unsigned int * const needsCleaning);
 
+    /**
+     *  @brief Outputs the Bash Tag suggestions, messages and cleanliness of
+     *         each of the given plugins.
+     *  @details This gives the same results as calling
+     *           loot_get_plugin_tags(), loot_get_plugin_messages() and
+     *           loot_get_dirty_info() for each plugin, but looks each plugin
+     *           up only once. loot_get_tag_map() must be called before this
+     *           to ensure that the Bash Tag UIDs outputted can be matched up
+     *           to name strings. The outputted array is valid until
+     *           loot_destroy_db() is called or this function is next called
+     *           by the same thread.
+     *  @param db
+     *      The database the function acts on.
+     *  @param plugins
+     *      An array of the filenames of the plugins to look up.
+     *  @param numPlugins
+     *      The size of the `plugins` array.
+     *  @param info
+     *      A pointer to the outputted array of plugin information, in the
+     *      same order as `plugins`. `NULL` if `numPlugins` is `0`.
+     *  @returns A return code.
+     */
+    LOOT_API unsigned int loot_get_plugins_info(loot_db db,
+                                                const char * const * const plugins,
+                                                const size_t numPlugins,
+                                                loot_plugin_info ** const info);
+
+    /**
+     *  @brief Frees the data that the database access functions and
+     *         loot_get_masterlist_revision() have output to the calling
+     *         thread.
+     *  @details Pointers previously output to the calling thread become
+     *           invalid. The thread can still call the database's functions
+     *           afterwards. Threads that are done with a database should
+     *           call this before they end, as their data is otherwise kept
+     *           until loot_destroy_db() is called.
+     *  @param db
+     *      The database the function acts on.
+     *  @returns A return code.
+     */
+    LOOT_API unsigned int loot_release_thread_outputs(loot_db db);
+
     /**
      *  @brief Writes a minimal metadata file that only contains plugins with
      *         Bash Tag suggestions and/or dirty info, plus the suggestions and
      *         info themselves.
+     *  @details Plugins are written in case-insensitive order of name, so
+     *           the files written for different revisions of a masterlist
+     *           can be compared line by line. The list is written to a
+     *           temporary file that replaces `outputFile` once it is
+     *           complete, so an existing file is left unchanged if an error
+     *           occurs.
      *  @param db
      *      The database the function acts on.
      *  @param outputFile
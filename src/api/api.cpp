@@ -26,6 +26,7 @@
 #include "../backend/game/game.h"
 #include "../backend/globals.h"
 #include "../backend/error.h"
+#include "../backend/helpers/cancellation.h"
 #include "../backend/helpers/streams.h"
 #include "../backend/plugin_sorter.h"
 
@@ -33,14 +34,23 @@
 
 #include <algorithm>
 #include <clocale>
+#include <cstring>
+#include <functional>
 #include <list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <type_traits>
 #include <vector>
-#include <unordered_set>
 #include <unordered_map>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/locale.hpp>
 #include <boost/log/core.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/shared_mutex.hpp>
 
 const unsigned int loot_ok = loot::error::ok;
 const unsigned int loot_error_liblo_error = loot::error::liblo_error;
@@ -56,7 +66,8 @@ const unsigned int loot_error_no_game_detected = loot::error::no_game_detected;
 const unsigned int loot_error_git_error = loot::error::git_error;
 const unsigned int loot_error_windows_error = loot::error::windows_error;
 const unsigned int loot_error_sorting_error = loot::error::sorting_error;
-const unsigned int loot_return_max = loot_error_sorting_error;
+const unsigned int loot_error_cancelled = loot::error::cancelled;
+const unsigned int loot_return_max = loot_error_cancelled;
 
 // The following are the games identifiers used by the API.
 const unsigned int loot_game_tes4 = loot::Game::tes4;
@@ -89,83 +100,279 @@ const unsigned int loot_needs_cleaning_no = 0;
 const unsigned int loot_needs_cleaning_yes = 1;
 const unsigned int loot_needs_cleaning_unknown = 2;
 
+// A bump allocator for the arrays and strings that the API outputs. Its
+// memory is reused rather than freed when it is reset for the next output,
+// and an output that fits in the size given to Reset() is packed into one
+// block.
+class ResultArena {
+public:
+    ResultArena() : used(0) {}
+
+    // Discards the previous output. If the arena's memory is split across
+    // blocks or is smaller than the given size, it is replaced by a single
+    // block that is large enough for both.
+    void Reset(const size_t size) {
+        size_t capacity = 0;
+        for (const auto blockSize : blockSizes)
+            capacity += blockSize;
+
+        if (blocks.size() > 1 || capacity < size) {
+            blocks.clear();
+            blockSizes.clear();
+            AddBlock(std::max(capacity, size));
+        }
+        used = 0;
+    }
+
+    // Returns uninitialised space for count objects, or nullptr if count is 0.
+    template<class T>
+    T * Allocate(const size_t count) {
+        if (count == 0)
+            return nullptr;
+
+        const size_t alignment = std::alignment_of<T>::value;
+        const size_t size = count * sizeof(T);
+        size_t offset = (used + alignment - 1) / alignment * alignment;
+        if (blocks.empty() || offset + size > blockSizes.back()) {
+            AddBlock(std::max(size, blocks.empty() ? minBlockSize : 2 * blockSizes.back()));
+            offset = 0;
+        }
+        used = offset + size;
+
+        return reinterpret_cast<T*>(blocks.back().get() + offset);
+    }
+
+    char * CopyString(const std::string& str) {
+        char * p = Allocate<char>(str.length() + 1);
+        memcpy(p, str.c_str(), str.length() + 1);
+        return p;
+    }
+
+    // The space needed for an array of count objects, including padding.
+    template<class T>
+    static size_t ArraySize(const size_t count) {
+        return count * sizeof(T) + std::alignment_of<T>::value;
+    }
+private:
+    static const size_t minBlockSize = 256;
+
+    void AddBlock(const size_t size) {
+        blocks.push_back(std::unique_ptr<char[]>(new char[size]));
+        blockSizes.push_back(size);
+        used = 0;
+    }
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    std::vector<size_t> blockSizes;
+    size_t used;  // Bytes used in the last block.
+};
+
+// The Bash Tags in a masterlist and userlist, interned when the lists are
+// loaded. The names are sorted, and a tag's ID is its index in them.
+struct TagTable {
+    std::vector<std::string> names;
+    std::unordered_map<std::string, unsigned int> ids;
+};
+
+// The IDs of the Bash Tags suggested for a plugin, in ascending order.
+struct PluginTagIds {
+    PluginTagIds() : userlistModified(false) {}
+
+    std::vector<unsigned int> added;
+    std::vector<unsigned int> removed;
+    bool userlistModified;
+};
+
+// The tag IDs that have been looked up for plugins, so that later queries
+// for the same plugin only copy them.
+class PluginTagCache {
+public:
+    // Gets the cached tag IDs for the plugin, calling lookUp to get them if
+    // they aren't cached.
+    std::shared_ptr<const PluginTagIds> Get(const std::string& plugin,
+                                            const std::function<PluginTagIds()>& lookUp) {
+        const std::string key(boost::locale::to_lower(plugin));
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            const auto it = plugins.find(key);
+            if (it != plugins.end())
+                return it->second;
+        }
+
+        // Looked up without the lock held, so that other queries aren't
+        // held up. If two threads look up the same plugin, the first to
+        // finish wins.
+        std::shared_ptr<const PluginTagIds> tagIds(std::make_shared<const PluginTagIds>(lookUp()));
+        std::lock_guard<std::mutex> guard(mutex);
+        return plugins.insert(std::make_pair(key, tagIds)).first->second;
+    }
+private:
+    std::mutex mutex;
+    // Keyed by lowercased plugin name.
+    std::unordered_map<std::string, std::shared_ptr<const PluginTagIds>> plugins;
+};
+
+// The evaluated metadata that the database access functions read. A
+// snapshot is never changed once it has been published: functions that
+// change the metadata build a new snapshot and swap it in, so queries can
+// keep reading the one they started with.
+struct MetadataSnapshot {
+    MetadataSnapshot()
+        : tags(std::make_shared<const TagTable>()),
+        tagMapOutput(false),
+        pluginTags(std::make_shared<PluginTagCache>()) {}
+
+    loot::Masterlist masterlist;
+    loot::MetadataList userlist;
+
+    // Includes the tags of every entry, whatever their conditions, so that
+    // the IDs don't change when the lists are evaluated.
+    std::shared_ptr<const TagTable> tags;
+    // Tags can't be queried until loot_get_tag_map() has output the tag map
+    // for these lists.
+    bool tagMapOutput;
+    // Shared by the snapshots of the same evaluated lists.
+    std::shared_ptr<PluginTagCache> pluginTags;
+};
+
+// The outputs returned to one thread by the database access functions.
+struct ThreadOutputs {
+    ThreadOutputs()
+        : extAddedTagIds(nullptr),
+        extRemovedTagIds(nullptr),
+        extMessageArray(nullptr),
+        extMessageArraySize(0),
+        extRevisionID(nullptr),
+        extRevisionDate(nullptr),
+        extPluginInfo(nullptr) {}
+
+    // Outputs are allocated from the arena for their kind, which is reset
+    // when that kind of output is next requested.
+    ResultArena revisionArena;
+    ResultArena tagIdsArena;
+    ResultArena messageArena;
+    ResultArena pluginInfoArena;
+
+    unsigned int * extAddedTagIds;
+    unsigned int * extRemovedTagIds;
+
+    loot_message * extMessageArray;
+    size_t extMessageArraySize;
+
+    char * extRevisionID;
+    char * extRevisionDate;
+
+    loot_plugin_info * extPluginInfo;
+};
+
 struct _loot_db_int : public loot::Game {
     _loot_db_int(const unsigned int clientGame, const std::string& gamePath, const boost::filesystem::path& gameLocalDataPath)
         : Game(clientGame),
         extTagMap(nullptr),
-        extAddedTagIds(nullptr),
-        extRemovedTagIds(nullptr),
-        extMessageArray(nullptr),
-        extMessageArraySize(0),
         extStringArray(nullptr),
         extStringArraySize(0),
-        extRevisionID(nullptr),
-        extRevisionDate(nullptr) {
+        snapshot(std::make_shared<const MetadataSnapshot>()) {
         this->SetGamePath(gamePath);
         this->Init(false, gameLocalDataPath);
     }
 
-    ~_loot_db_int() {
-        delete[] extAddedTagIds;
-        delete[] extRemovedTagIds;
-        delete[] extRevisionID;
-        delete[] extRevisionDate;
+    // Gets the current metadata snapshot.
+    std::shared_ptr<const MetadataSnapshot> Snapshot() const {
+        return std::atomic_load(&snapshot);
+    }
 
-        if (extTagMap != nullptr) {
-            for (size_t i = 0; i < bashTagMap.size(); i++)
-                delete[] extTagMap[i];  //Gotta clear those allocated strings.
-            delete[] extTagMap;
-        }
+    void Publish(const std::shared_ptr<const MetadataSnapshot>& newSnapshot) {
+        std::atomic_store(&snapshot, newSnapshot);
+    }
 
-        if (extMessageArray != nullptr) {
-            for (size_t i = 0; i < extMessageArraySize; i++)
-                delete[] extMessageArray[i].message;  //Gotta clear those allocated strings.
-            delete[] extMessageArray;
-        }
+    // Gets the outputs for the calling thread. Each thread has its own, so
+    // that concurrent queries don't overwrite each other's outputs.
+    ThreadOutputs& Outputs() {
+        std::lock_guard<std::mutex> guard(outputsMutex);
+        std::unique_ptr<ThreadOutputs>& outputs = threadOutputs[std::this_thread::get_id()];
+        if (!outputs)
+            outputs.reset(new ThreadOutputs());
+        return *outputs;
+    }
 
-        if (extStringArray != nullptr) {
-            for (size_t i = 0; i < extStringArraySize; i++)
-                delete[] extStringArray[i];  //Gotta clear those allocated strings.
-            delete[] extStringArray;
-        }
+    // Frees the outputs for the calling thread. Outputs are otherwise kept
+    // until the handle is destroyed, as there's no way to tell when a
+    // thread has ended, and a new thread may be given an ended thread's ID.
+    void ReleaseOutputs() {
+        std::lock_guard<std::mutex> guard(outputsMutex);
+        threadOutputs.erase(std::this_thread::get_id());
     }
 
+    // Functions that change the database's state are serialised by this
+    // mutex, and only they use the members below it, other than the game
+    // state.
+    std::mutex writeMutex;
+
+    // Guards the game state that conditions are evaluated against, which
+    // entries that are evaluated on lookup read. Held exclusively while
+    // that state is refreshed or the plugins are loaded, and shared while
+    // it is read.
+    mutable boost::shared_mutex gameMutex;
+
     loot::MetadataList rawUserMetadata;
-    loot::Masterlist rawMetadata;
+    // Shared with any other handles that loaded the same masterlist.
+    std::shared_ptr<const loot::Masterlist> rawMetadata;
 
-    std::unordered_map<std::string, unsigned int> bashTagMap;
+    ResultArena tagMapArena;
+    ResultArena stringArrayArena;
 
     char ** extTagMap;
 
     char ** extStringArray;
     size_t extStringArraySize;
+private:
+    // Only accessed through Snapshot() and Publish().
+    std::shared_ptr<const MetadataSnapshot> snapshot;
 
-    char * extRevisionID;
-    char * extRevisionDate;
+    std::mutex outputsMutex;
+    std::unordered_map<std::thread::id, std::unique_ptr<ThreadOutputs>> threadOutputs;
+};
 
-    unsigned int * extAddedTagIds;
-    unsigned int * extRemovedTagIds;
+// A sort running in its own thread.
+struct _loot_sort_job_int {
+    _loot_sort_job_int()
+        : returnCode(loot::error::ok),
+        extSortedPlugins(nullptr),
+        extNumPlugins(0) {}
+
+    loot::CancellationToken cancellation;
+    std::thread thread;
+
+    // Waits for the sorting thread to finish. Safe to call from several
+    // threads at once.
+    void Join() {
+        std::lock_guard<std::mutex> guard(joinMutex);
+        if (thread.joinable())
+            thread.join();
+    }
 
-    loot_message * extMessageArray;
-    size_t extMessageArraySize;
+    // Written by the sorting thread, and only read once it has been joined.
+    unsigned int returnCode;
+    std::string errorMessage;
+    ResultArena arena;
+    char ** extSortedPlugins;
+    size_t extNumPlugins;
+private:
+    std::mutex joinMutex;
 };
 
-char * extMessageStr = nullptr;
-
-// std::string to null-terminated char string converter.
-char * ToNewCString(std::string str) {
-    char * p = new char[str.length() + 1];
-    return strcpy(p, str.c_str());
-}
+// Error details are kept for each thread, so that an error in one thread
+// doesn't free the string that another thread is reading.
+std::mutex errorMessagesMutex;
+std::unordered_map<std::thread::id, std::string> errorMessages;
 
 unsigned int c_error(const loot::error& e) {
-    delete[] extMessageStr;
+    std::lock_guard<std::mutex> guard(errorMessagesMutex);
     try {
-        extMessageStr = new char[strlen(e.what()) + 1];
-        strcpy(extMessageStr, e.what());
+        errorMessages[std::this_thread::get_id()] = e.what();
     }
     catch (std::bad_alloc& /*e*/) {
-        extMessageStr = nullptr;
+        errorMessages.erase(std::this_thread::get_id());
     }
     return e.code();
 }
@@ -174,26 +381,108 @@ unsigned int c_error(const unsigned int code, const std::string& what) {
     return c_error(loot::error(code, what.c_str()));
 }
 
+// Interns the names of the Bash Tags in the given lists.
+std::shared_ptr<const TagTable> InternTags(const loot::MetadataList& masterlist,
+                                           const loot::MetadataList& userlist) {
+    std::set<std::string> tagNames;
+    masterlist.CollectTagNames(tagNames);
+    userlist.CollectTagNames(tagNames);
+
+    std::shared_ptr<TagTable> tags(std::make_shared<TagTable>());
+    tags->names.assign(tagNames.begin(), tagNames.end());
+    for (size_t i = 0; i < tags->names.size(); ++i) {
+        tags->ids.insert(std::make_pair(tags->names[i], static_cast<unsigned int>(i)));
+    }
+    return tags;
+}
+
+// Gets the IDs of the Bash Tags suggested for addition and removal by the
+// given masterlist and userlist entries for a plugin.
+PluginTagIds GetTagIds(const TagTable& tags,
+                       const loot::PluginMetadata& masterlistPlugin,
+                       const loot::PluginMetadata& userlistPlugin) {
+    PluginTagIds tagIds;
+    const auto addTagIds = [&](const loot::PluginMetadata& plugin) {
+        for (const auto &tag : plugin.Tags()) {
+            const auto mapIter(tags.ids.find(tag.Name()));
+            if (mapIter == tags.ids.end())
+                continue;
+            if (tag.IsAddition())
+                tagIds.added.push_back(mapIter->second);
+            else
+                tagIds.removed.push_back(mapIter->second);
+        }
+    };
+    addTagIds(masterlistPlugin);
+    addTagIds(userlistPlugin);
+    tagIds.userlistModified = !userlistPlugin.Tags().empty();
+
+    // IDs are in the same order as the tag names.
+    for (auto ids : { &tagIds.added, &tagIds.removed }) {
+        std::sort(ids->begin(), ids->end());
+        ids->erase(std::unique(ids->begin(), ids->end()), ids->end());
+    }
+    return tagIds;
+}
+
+// Gets the masterlist messages for a plugin, followed by its userlist messages.
+std::vector<loot::Message> GetMessages(const loot::PluginMetadata& masterlistPlugin,
+                                       const loot::PluginMetadata& userlistPlugin) {
+    std::vector<loot::Message> messages;
+    messages.reserve(masterlistPlugin.Messages().size() + userlistPlugin.Messages().size());
+    messages.insert(messages.end(), masterlistPlugin.Messages().begin(), masterlistPlugin.Messages().end());
+    messages.insert(messages.end(), userlistPlugin.Messages().begin(), userlistPlugin.Messages().end());
+    return messages;
+}
+
+// Gets a plugin's cleanliness code from its dirty info and messages.
+unsigned int GetCleanliness(const loot::PluginMetadata& masterlistPlugin,
+                            const loot::PluginMetadata& userlistPlugin,
+                            const std::vector<loot::Message>& messages) {
+    unsigned int needsCleaning = loot_needs_cleaning_unknown;
+
+    // Is there any dirty info? Testing for applicability happens in loot_eval_lists().
+    if (!masterlistPlugin.DirtyInfo().empty() || !userlistPlugin.DirtyInfo().empty())
+        needsCleaning = loot_needs_cleaning_yes;
+
+    // Is there a message beginning with the substring "Do not clean."?
+    // This isn't a very reliable system, because if the lists have been evaluated in some language
+    // other than English, the strings will be in different languages (and the API can't tell what they'd be)
+    // and the strings may be non-standard and begin with something other than "Do not clean." anyway.
+    for (const auto& message : messages) {
+        if (boost::starts_with(message.ChooseContent(loot::Language::english).Str(), "Do not clean"))
+            return loot_needs_cleaning_no;
+    }
+
+    return needsCleaning;
+}
+
 //////////////////////////////
 // Error Handling Functions
 //////////////////////////////
 
 // Outputs a string giving the details of the last time an error or
-// warning return code was returned by a function. The string exists
-// until this function is called again or until CleanUpAPI is called.
+// warning return code was returned by a function in the calling thread.
+// The string exists until another error occurs in the thread or until
+// CleanUpAPI is called by it.
 LOOT_API unsigned int loot_get_error_message(const char ** const message) {
     if (message == nullptr)
         return c_error(loot_error_invalid_args, "Null message pointer passed.");
 
-    *message = extMessageStr;
+    std::lock_guard<std::mutex> guard(errorMessagesMutex);
+    const auto it = errorMessages.find(std::this_thread::get_id());
+    if (it == errorMessages.end())
+        *message = nullptr;
+    else
+        *message = it->second.c_str();
 
     return loot_ok;
 }
 
-// Frees memory allocated to error string.
+// Frees memory allocated to the calling thread's error string.
 LOOT_API void     loot_cleanup() {
-    delete[] extMessageStr;
-    extMessageStr = nullptr;
+    std::lock_guard<std::mutex> guard(errorMessagesMutex);
+    errorMessages.erase(std::this_thread::get_id());
 }
 
 //////////////////////////////
@@ -312,12 +601,12 @@ LOOT_API unsigned int loot_load_lists(loot_db db, const char * const masterlistP
     if (db == nullptr || masterlistPath == nullptr)
         return c_error(loot_error_invalid_args, "Null pointer passed.");
 
-    loot::Masterlist temp;
+    std::shared_ptr<const loot::Masterlist> temp;
     loot::MetadataList userTemp;
 
     try {
         if (boost::filesystem::exists(masterlistPath)) {
-            temp.Load(masterlistPath);
+            temp = loot::Masterlist::LoadShared(masterlistPath);
         }
         else {
             return c_error(loot_error_path_not_found, std::string("The given masterlist path does not exist: ") + masterlistPath);
@@ -341,33 +630,24 @@ LOOT_API unsigned int loot_load_lists(loot_db db, const char * const masterlistP
         return c_error(loot_error_parse_fail, e.what());
     }
 
-    //Also free memory.
-    db->bashTagMap.clear();
-    delete[] db->extAddedTagIds;
-    delete[] db->extRemovedTagIds;
+    std::shared_ptr<MetadataSnapshot> snapshot(std::make_shared<MetadataSnapshot>());
+    snapshot->masterlist = *temp;
+    snapshot->userlist = userTemp;
+    snapshot->tags = InternTags(*temp, userTemp);
 
-    if (db->extTagMap != nullptr) {
-        for (size_t i = 0; i < db->bashTagMap.size(); i++)
-            delete[] db->extTagMap[i];  //Gotta clear those allocated strings.
-        delete[] db->extTagMap;
-    }
-
-    if (db->extMessageArray != nullptr) {
-        for (size_t i = 0; i < db->extMessageArraySize; i++)
-            delete[] db->extMessageArray[i].message;  //Gotta clear those allocated strings.
-        delete[] db->extMessageArray;
-    }
+    std::lock_guard<std::mutex> guard(db->writeMutex);
 
-    db->extAddedTagIds = nullptr;
-    db->extRemovedTagIds = nullptr;
+    //Also free memory.
+    db->tagMapArena.Reset(0);
     db->extTagMap = nullptr;
-    db->extMessageArray = nullptr;
 
-    db->masterlist = temp;
+    db->masterlist = *temp;
     db->rawMetadata = temp;
     db->userlist = userTemp;
     db->rawUserMetadata = userTemp;
 
+    db->Publish(snapshot);
+
     return loot_ok;
 }
 
@@ -393,14 +673,36 @@ LOOT_API unsigned int loot_eval_lists(loot_db db, const unsigned int language) {
         && language != loot_lang_danish)
         return c_error(loot_error_invalid_args, "Invalid language code given.");
 
-    // Clear caches before evaluating conditions.
-    db->ClearCache();
+    std::lock_guard<std::mutex> guard(db->writeMutex);
 
-    loot::Masterlist temp = db->rawMetadata;
+    // The copies share their entries with the raw lists, and evaluation
+    // only replaces the entries that it changes.
+    loot::Masterlist temp = db->rawMetadata ? *db->rawMetadata : loot::Masterlist();
     loot::MetadataList userTemp = db->rawUserMetadata;
     try {
-        // Refresh active plugins before evaluating conditions.
-        db->RefreshActivePluginsList();
+        {
+            boost::unique_lock<boost::shared_mutex> gameLock(db->gameMutex);
+
+            // Refresh the Data folder listing and discard cached results
+            // for paths that have changed since they were cached. Active
+            // plugin changes are handled by the refresh below.
+            db->InvalidateChangedPaths();
+
+            // Refresh active plugins before evaluating conditions.
+            db->RefreshActivePluginsList();
+        }
+
+        // Evaluation only adds to the game's caches, which are safe to
+        // fill while queries read the game.
+        boost::shared_lock<boost::shared_mutex> gameLock(db->gameMutex);
+
+        // Run the filesystem checks made by conditions in parallel first,
+        // then evaluate the conditions themselves from the cached results.
+        std::set<std::string> probes;
+        temp.CollectProbes(probes, *db);
+        userTemp.CollectProbes(probes, *db);
+        db->EvalConditionProbes(probes);
+
         temp.EvalAllConditions(*db, language);
         userTemp.EvalAllConditions(*db, language);
     }
@@ -410,6 +712,16 @@ LOOT_API unsigned int loot_eval_lists(loot_db db, const unsigned int language) {
     db->masterlist = temp;
     db->userlist = userTemp;
 
+    std::shared_ptr<MetadataSnapshot> snapshot(std::make_shared<MetadataSnapshot>());
+    snapshot->masterlist = temp;
+    snapshot->userlist = userTemp;
+    // The tags were interned from the raw lists, so evaluation doesn't
+    // change them.
+    const std::shared_ptr<const MetadataSnapshot> current(db->Snapshot());
+    snapshot->tags = current->tags;
+    snapshot->tagMapOutput = current->tagMapOutput;
+    db->Publish(snapshot);
+
     return loot_ok;
 }
 
@@ -417,41 +729,66 @@ LOOT_API unsigned int loot_eval_lists(loot_db db, const unsigned int language) {
 // LOOT Functionality Functions
 ////////////////////////////////////
 
+// Loads all the plugins and sorts them. The caller must hold the handle's
+// write mutex.
+std::list<loot::Plugin> SortPlugins(loot_db db,
+                                    const std::function<void(const std::string&)>& progressCallback,
+                                    const loot::CancellationToken& cancellation) {
+    // Send the message before locking the game state, so that the
+    // client isn't called back while queries are blocked.
+    progressCallback(boost::locale::translate("Loading plugin contents..."));
+    {
+        // Only plugins that have changed since they were last loaded are
+        // reloaded.
+        boost::unique_lock<boost::shared_mutex> gameLock(db->gameMutex);
+        db->LoadPlugins(false, cancellation);
+    }
+
+    // Queries can run while the loaded plugins are sorted.
+    boost::shared_lock<boost::shared_mutex> gameLock(db->gameMutex);
+
+    //Sort plugins into their load order.
+    loot::PluginSorter sorter;
+    return sorter.Sort(*db, loot_lang_any, progressCallback, cancellation);
+}
+
+// Copies the names of the given plugins into the arena, returning the array
+// of names.
+char ** CopyPluginNames(ResultArena& arena, const std::list<loot::Plugin>& plugins) {
+    size_t size = ResultArena::ArraySize<char*>(plugins.size());
+    for (const auto &plugin : plugins) {
+        size += plugin.Name().length() + 1;
+    }
+    arena.Reset(size);
+
+    char ** names = arena.Allocate<char*>(plugins.size());
+    size_t i = 0;
+    for (const auto &plugin : plugins) {
+        names[i] = arena.CopyString(plugin.Name());
+        ++i;
+    }
+    return names;
+}
+
 LOOT_API unsigned int loot_sort_plugins(loot_db db,
                                         char *** const sortedPlugins,
                                         size_t * const numPlugins) {
     if (db == nullptr || sortedPlugins == nullptr || numPlugins == nullptr)
         return c_error(loot_error_invalid_args, "Null pointer passed.");
 
-    //Clear existing array allocation.
-    if (db->extStringArray != nullptr) {
-        for (size_t i = 0; i < db->extStringArraySize; ++i) {
-            delete[] db->extStringArray[i];
-        }
-        delete[] db->extStringArray;
-        db->extStringArray = nullptr;
-    }
+    std::lock_guard<std::mutex> guard(db->writeMutex);
 
     //Initialise output.
     *numPlugins = 0;
     *sortedPlugins = nullptr;
+    db->extStringArray = nullptr;
+    db->extStringArraySize = 0;
 
     try {
-        // Always reload all the plugins.
-        db->LoadPlugins(false);
-
-        //Sort plugins into their load order.
-        loot::PluginSorter sorter;
-        std::list<loot::Plugin> plugins = sorter.Sort(*db, loot_lang_any, [](const std::string& message) {});
+        std::list<loot::Plugin> plugins = SortPlugins(db, [](const std::string& message) {}, loot::CancellationToken());
 
+        db->extStringArray = CopyPluginNames(db->stringArrayArena, plugins);
         db->extStringArraySize = plugins.size();
-        db->extStringArray = new char*[db->extStringArraySize];
-
-        size_t i = 0;
-        for (const auto &plugin : plugins) {
-            db->extStringArray[i] = ToNewCString(plugin.Name());
-            ++i;
-        }
     }
     catch (loot::error &e) {
         return c_error(e);
@@ -466,12 +803,128 @@ LOOT_API unsigned int loot_sort_plugins(loot_db db,
     return loot_ok;
 }
 
+// Starts sorting plugins in a new thread. The job must be destroyed before
+// the db it was started for.
+LOOT_API unsigned int loot_start_sort(loot_db db,
+                                      const loot_progress_callback progressCallback,
+                                      void * const userData,
+                                      loot_sort_job * const job) {
+    if (db == nullptr || job == nullptr)
+        return c_error(loot_error_invalid_args, "Null pointer passed.");
+
+    *job = nullptr;
+
+    try {
+        std::unique_ptr<_loot_sort_job_int> newJob(new _loot_sort_job_int());
+        _loot_sort_job_int * const sortJob = newJob.get();
+
+        newJob->thread = std::thread([db, sortJob, progressCallback, userData]() {
+            std::function<void(const std::string&)> callback = [](const std::string& message) {};
+            if (progressCallback != nullptr) {
+                callback = [progressCallback, userData](const std::string& message) {
+                    progressCallback(message.c_str(), userData);
+                };
+            }
+
+            try {
+                std::lock_guard<std::mutex> guard(db->writeMutex);
+                std::list<loot::Plugin> plugins = SortPlugins(db, callback, sortJob->cancellation);
+
+                sortJob->extSortedPlugins = CopyPluginNames(sortJob->arena, plugins);
+                sortJob->extNumPlugins = plugins.size();
+            }
+            catch (loot::error& e) {
+                sortJob->returnCode = e.code();
+                sortJob->errorMessage = e.what();
+            }
+            catch (std::bad_alloc& e) {
+                sortJob->returnCode = loot_error_no_mem;
+                sortJob->errorMessage = e.what();
+            }
+            catch (std::exception& e) {
+                sortJob->returnCode = loot_error_sorting_error;
+                sortJob->errorMessage = e.what();
+            }
+        });
+
+        *job = newJob.release();
+    }
+    catch (std::bad_alloc& e) {
+        return c_error(loot_error_no_mem, e.what());
+    }
+    catch (std::exception& e) {
+        return c_error(loot_error_sorting_error, e.what());
+    }
+
+    return loot_ok;
+}
+
+// Asks the job to stop sorting. The job stops at its next cancellation
+// check, and waiting for it then gives loot_error_cancelled.
+LOOT_API unsigned int loot_cancel_sort(loot_sort_job job) {
+    if (job == nullptr)
+        return c_error(loot_error_invalid_args, "Null pointer passed.");
+
+    job->cancellation.Cancel();
+
+    return loot_ok;
+}
+
+// Blocks until the job has finished, then outputs its result. The output is
+// valid until the job is destroyed.
+LOOT_API unsigned int loot_wait_for_sort(loot_sort_job job,
+                                         char *** const sortedPlugins,
+                                         size_t * const numPlugins) {
+    if (job == nullptr || sortedPlugins == nullptr || numPlugins == nullptr)
+        return c_error(loot_error_invalid_args, "Null pointer passed.");
+
+    *sortedPlugins = nullptr;
+    *numPlugins = 0;
+
+    job->Join();
+
+    if (job->returnCode != loot_ok)
+        return c_error(job->returnCode, job->errorMessage);
+
+    *sortedPlugins = job->extSortedPlugins;
+    *numPlugins = job->extNumPlugins;
+
+    return loot_ok;
+}
+
+// Cancels the job if it is still running, waits for it to stop, then frees
+// it.
+LOOT_API void     loot_destroy_sort_job(loot_sort_job job) {
+    if (job == nullptr)
+        return;
+
+    job->cancellation.Cancel();
+    job->Join();
+
+    delete job;
+}
+
+// Makes the next sort reload every plugin, instead of only those whose size
+// or modification time has changed.
+LOOT_API unsigned int loot_invalidate_plugins(loot_db db) {
+    if (db == nullptr)
+        return c_error(loot_error_invalid_args, "Null pointer passed.");
+
+    std::lock_guard<std::mutex> guard(db->writeMutex);
+    boost::unique_lock<boost::shared_mutex> gameLock(db->gameMutex);
+    db->ClearLoadedPluginStamps();
+
+    return loot_ok;
+}
+
 LOOT_API unsigned int loot_apply_load_order(loot_db db,
                                             const char * const * const loadOrder,
                                             const size_t numPlugins) {
     if (db == nullptr || loadOrder == nullptr)
         return c_error(loot_error_invalid_args, "Null pointer passed.");
 
+    std::lock_guard<std::mutex> guard(db->writeMutex);
+
     try {
         db->SetLoadOrder(loadOrder, numPlugins);
     }
@@ -518,6 +971,7 @@ LOOT_API unsigned int loot_get_masterlist_revision(loot_db db,
     *revisionDate = nullptr;
     *isModified = false;
 
+    ThreadOutputs& outputs = db->Outputs();
     bool edited = false;
     try {
         loot::Masterlist::Info info = loot::Masterlist::GetInfo(masterlistPath, getShortID);
@@ -530,8 +984,9 @@ LOOT_API unsigned int loot_get_masterlist_revision(loot_db db,
             edited = true;
         }
 
-        db->extRevisionID = ToNewCString(id);
-        db->extRevisionDate = ToNewCString(date);
+        outputs.revisionArena.Reset(id.length() + date.length() + 2);
+        outputs.extRevisionID = outputs.revisionArena.CopyString(id);
+        outputs.extRevisionDate = outputs.revisionArena.CopyString(date);
     }
     catch (loot::error &e) {
         if (e.code() == loot_ok)
@@ -543,8 +998,8 @@ LOOT_API unsigned int loot_get_masterlist_revision(loot_db db,
         return c_error(loot_error_no_mem, e.what());
     }
 
-    *revisionID = db->extRevisionID;
-    *revisionDate = db->extRevisionDate;
+    *revisionID = outputs.extRevisionID;
+    *revisionDate = outputs.extRevisionDate;
     *isModified = edited;
 
     return loot_ok;
@@ -561,66 +1016,53 @@ LOOT_API unsigned int loot_get_tag_map(loot_db db, char *** const tagMap, size_t
     if (db == nullptr || tagMap == nullptr || numTags == nullptr)
         return c_error(loot_error_invalid_args, "Null pointer passed.");
 
-    //Clear existing array allocation.
-    if (db->extTagMap != nullptr) {
-        for (size_t i = 0, max = db->bashTagMap.size(); i < max; ++i) {
-            delete[] db->extTagMap[i];
-        }
-        delete[] db->extTagMap;
-        db->extTagMap = nullptr;
-    }
+    std::lock_guard<std::mutex> guard(db->writeMutex);
 
     //Initialise output.
     *tagMap = nullptr;
     *numTags = 0;
+    db->extTagMap = nullptr;
 
-    std::set<std::string> allTags;
-
-    for (const auto &plugin : db->masterlist.Plugins()) {
-        for (const auto &tag : plugin.Tags()) {
-            allTags.insert(tag.Name());
-        }
-    }
-    for (const auto &plugin : db->userlist.Plugins()) {
-        for (const auto &tag : plugin.Tags()) {
-            allTags.insert(tag.Name());
-        }
-    }
-
-    if (allTags.empty())
+    // The tags were interned when the lists were loaded.
+    const std::shared_ptr<const MetadataSnapshot> current(db->Snapshot());
+    const std::vector<std::string>& tagNames = current->tags->names;
+    if (tagNames.empty())
         return loot_ok;
 
     try {
-        db->extTagMap = new char*[allTags.size()];
-    }
-    catch (std::bad_alloc& e) {
-        return c_error(loot_error_no_mem, e.what());
-    }
+        size_t size = ResultArena::ArraySize<char*>(tagNames.size());
+        for (const auto &tag : tagNames) {
+            size += tag.length() + 1;
+        }
+        db->tagMapArena.Reset(size);
+        db->extTagMap = db->tagMapArena.Allocate<char*>(tagNames.size());
 
-    try {
-        unsigned int UID = 0;
-        for (const auto &tag : allTags) {
-            db->bashTagMap.insert(std::pair<std::string, unsigned int>(tag, UID));
-            //Also allocate memory.
-            db->extTagMap[UID] = ToNewCString(tag);
-            UID++;
+        for (size_t i = 0; i < tagNames.size(); ++i) {
+            db->extTagMap[i] = db->tagMapArena.CopyString(tagNames[i]);
+        }
+
+        if (!current->tagMapOutput) {
+            std::shared_ptr<MetadataSnapshot> snapshot(std::make_shared<MetadataSnapshot>(*current));
+            snapshot->tagMapOutput = true;
+            db->Publish(snapshot);
         }
     }
     catch (std::bad_alloc& e) {
+        db->extTagMap = nullptr;
         return c_error(loot_error_no_mem, e.what());
     }
 
     *tagMap = db->extTagMap;
-    *numTags = allTags.size();
+    *numTags = tagNames.size();
 
     return loot_ok;
 }
 
 // Returns arrays of Bash Tag UIDs for Bash Tags suggested for addition and removal
 // by LOOT's masterlist and userlist, and the number of tags in each array.
-// The returned arrays are valid until the db is destroyed or until the Load
-// function is called.  The arrays should not be freed by the client. modName is
-// case-insensitive. If no Tags are found for an array, the array pointer (*tagIds)
+// The returned arrays are valid until the db is destroyed or until the calling
+// thread next calls this function. The arrays should not be freed by the client.
+// modName is case-insensitive. If no Tags are found for an array, the array pointer (*tagIds)
 // will be nullptr. The userlistModified bool is true if the userlist contains Bash Tag
 // suggestion message additions.
 LOOT_API unsigned int loot_get_plugin_tags(loot_db db, const char * const plugin,
@@ -632,16 +1074,11 @@ LOOT_API unsigned int loot_get_plugin_tags(loot_db db, const char * const plugin
     if (db == nullptr || plugin == nullptr || tagIds_added == nullptr || numTags_added == nullptr || tagIds_removed == nullptr || numTags_removed == nullptr || userlistModified == nullptr)
         return c_error(loot_error_invalid_args, "Null pointer passed.");
 
-    if (db->bashTagMap.empty()) {
+    const std::shared_ptr<const MetadataSnapshot> snapshot(db->Snapshot());
+    if (!snapshot->tagMapOutput) {
         return c_error(loot_error_no_tag_map, "No Bash Tag map has been previously generated.");
     }
 
-    //Clear existing array allocations.
-    delete[] db->extAddedTagIds;
-    delete[] db->extRemovedTagIds;
-    db->extAddedTagIds = nullptr;
-    db->extRemovedTagIds = nullptr;
-
     //Initialise output.
     *tagIds_added = nullptr;
     *tagIds_removed = nullptr;
@@ -649,67 +1086,55 @@ LOOT_API unsigned int loot_get_plugin_tags(loot_db db, const char * const plugin
     *numTags_added = 0;
     *numTags_removed = 0;
 
-    std::set<std::string> tagsAdded, tagsRemoved;
-    loot::PluginMetadata p = db->masterlist.FindPlugin(loot::PluginMetadata(plugin));
-    for (const auto &tag : p.Tags()) {
-        if (tag.IsAddition())
-            tagsAdded.insert(tag.Name());
-        else
-            tagsRemoved.insert(tag.Name());
+    // The plugin is only looked up in the lists the first time its tags
+    // are queried for these lists.
+    std::shared_ptr<const PluginTagIds> tagIds;
+    try {
+        tagIds = snapshot->pluginTags->Get(plugin, [&]() -> PluginTagIds {
+            boost::shared_lock<boost::shared_mutex> gameLock(db->gameMutex);
+            return GetTagIds(*snapshot->tags,
+                             snapshot->masterlist.FindPlugin(loot::PluginMetadata(plugin)),
+                             snapshot->userlist.FindPlugin(loot::PluginMetadata(plugin)));
+        });
     }
-
-    p = db->userlist.FindPlugin(loot::PluginMetadata(plugin));
-    *userlistModified = !p.Tags().empty();
-    for (const auto &tag : p.Tags()) {
-        *userlistModified = true;
-        if (tag.IsAddition())
-            tagsAdded.insert(tag.Name());
-        else
-            tagsRemoved.insert(tag.Name());
+    catch (loot::error& e) {
+        return c_error(e);
     }
-
-    std::vector<unsigned int> tagsAddedIDs, tagsRemovedIDs;
-    for (const auto &tagName : tagsAdded) {
-        const auto mapIter(db->bashTagMap.find(tagName));
-        if (mapIter != db->bashTagMap.end())
-            tagsAddedIDs.push_back(mapIter->second);
+    catch (std::bad_alloc& e) {
+        return c_error(loot_error_no_mem, e.what());
     }
-    for (const auto &tagName : tagsRemoved) {
-        const auto mapIter(db->bashTagMap.find(tagName));
-        if (mapIter != db->bashTagMap.end())
-            tagsRemovedIDs.push_back(mapIter->second);
+    catch (std::exception& e) {
+        return c_error(loot_error_condition_eval_fail, e.what());
     }
+    *userlistModified = tagIds->userlistModified;
 
     //Allocate memory.
-    size_t numAdded = tagsAddedIDs.size();
-    size_t numRemoved = tagsRemovedIDs.size();
+    size_t numAdded = tagIds->added.size();
+    size_t numRemoved = tagIds->removed.size();
+    ThreadOutputs& outputs = db->Outputs();
     try {
-        if (numAdded != 0) {
-            db->extAddedTagIds = new uint32_t[numAdded];
-            for (size_t i = 0; i < numAdded; i++)
-                db->extAddedTagIds[i] = tagsAddedIDs[i];
-        }
-        if (numRemoved != 0) {
-            db->extRemovedTagIds = new uint32_t[numRemoved];
-            for (size_t i = 0; i < numRemoved; i++)
-                db->extRemovedTagIds[i] = tagsRemovedIDs[i];
-        }
+        outputs.tagIdsArena.Reset(ResultArena::ArraySize<unsigned int>(numAdded) + ResultArena::ArraySize<unsigned int>(numRemoved));
+        outputs.extAddedTagIds = outputs.tagIdsArena.Allocate<unsigned int>(numAdded);
+        outputs.extRemovedTagIds = outputs.tagIdsArena.Allocate<unsigned int>(numRemoved);
+        std::copy(tagIds->added.begin(), tagIds->added.end(), outputs.extAddedTagIds);
+        std::copy(tagIds->removed.begin(), tagIds->removed.end(), outputs.extRemovedTagIds);
     }
     catch (std::bad_alloc& e) {
         return c_error(loot_error_no_mem, e.what());
     }
 
     //Set outputs.
-    *tagIds_added = db->extAddedTagIds;
-    *tagIds_removed = db->extRemovedTagIds;
+    *tagIds_added = outputs.extAddedTagIds;
+    *tagIds_removed = outputs.extRemovedTagIds;
     *numTags_added = numAdded;
     *numTags_removed = numRemoved;
 
     return loot_ok;
 }
 
-// Returns the messages attached to the given plugin. Messages are valid until Load,
-// loot_destroy_db or loot_get_plugin_messages are next called. plugin is case-insensitive.
+// Returns the messages attached to the given plugin. Messages are valid until
+// loot_destroy_db is called or the calling thread next calls
+// loot_get_plugin_messages. plugin is case-insensitive.
 // If no messages are attached, *messages will be nullptr and numMessages will equal 0.
 LOOT_API unsigned int loot_get_plugin_messages(loot_db db, const char * const plugin,
                                                loot_message ** const messages,
@@ -717,45 +1142,54 @@ LOOT_API unsigned int loot_get_plugin_messages(loot_db db, const char * const pl
     if (db == nullptr || plugin == nullptr || messages == nullptr || numMessages == nullptr)
         return c_error(loot_error_invalid_args, "Null pointer passed.");
 
-    //Clear existing array allocation.
-    if (db->extMessageArray != nullptr) {
-        for (size_t i = 0; i < db->extMessageArraySize; ++i) {
-            delete[] db->extMessageArray[i].message;
-        }
-        delete[] db->extMessageArray;
-        db->extMessageArray = nullptr;
-        db->extMessageArraySize = 0;
-    }
-
     //Initialise output.
     *messages = nullptr;
     *numMessages = 0;
+    ThreadOutputs& outputs = db->Outputs();
+    outputs.extMessageArray = nullptr;
+    outputs.extMessageArraySize = 0;
 
-    loot::PluginMetadata p = db->masterlist.FindPlugin(loot::PluginMetadata(plugin));
-    std::list<loot::Message> pluginMessages(p.Messages());
-
-    p = db->userlist.FindPlugin(loot::PluginMetadata(plugin));
-    std::list<loot::Message> temp(p.Messages());
-    pluginMessages.insert(pluginMessages.end(), temp.begin(), temp.end());
+    const std::shared_ptr<const MetadataSnapshot> snapshot(db->Snapshot());
+    std::vector<loot::Message> pluginMessages;
+    try {
+        boost::shared_lock<boost::shared_mutex> gameLock(db->gameMutex);
+        pluginMessages = GetMessages(snapshot->masterlist.FindPlugin(loot::PluginMetadata(plugin)),
+                                     snapshot->userlist.FindPlugin(loot::PluginMetadata(plugin)));
+    }
+    catch (loot::error& e) {
+        return c_error(e);
+    }
+    catch (std::bad_alloc& e) {
+        return c_error(loot_error_no_mem, e.what());
+    }
+    catch (std::exception& e) {
+        return c_error(loot_error_condition_eval_fail, e.what());
+    }
 
     if (!pluginMessages.empty()) {
-        db->extMessageArraySize = pluginMessages.size();
         try {
-            db->extMessageArray = new loot_message[db->extMessageArraySize];
-            int i = 0;
+            std::vector<std::string> contents;
+            size_t size = ResultArena::ArraySize<loot_message>(pluginMessages.size());
             for (const auto &message : pluginMessages) {
-                db->extMessageArray[i].type = message.Type();
-                db->extMessageArray[i].message = ToNewCString(message.ChooseContent(loot::Language::any).Str());
-                ++i;
+                contents.push_back(message.ChooseContent(loot::Language::any).Str());
+                size += contents.back().length() + 1;
+            }
+            outputs.messageArena.Reset(size);
+
+            outputs.extMessageArray = outputs.messageArena.Allocate<loot_message>(pluginMessages.size());
+            for (size_t i = 0; i < pluginMessages.size(); ++i) {
+                outputs.extMessageArray[i].type = pluginMessages[i].Type();
+                outputs.extMessageArray[i].message = outputs.messageArena.CopyString(contents[i]);
             }
+            outputs.extMessageArraySize = pluginMessages.size();
         }
         catch (std::bad_alloc& e) {
             return c_error(loot_error_no_mem, e.what());
         }
     }
 
-    *messages = db->extMessageArray;
-    *numMessages = db->extMessageArraySize;
+    *messages = outputs.extMessageArray;
+    *numMessages = outputs.extMessageArraySize;
 
     return loot_ok;
 }
@@ -764,29 +1198,154 @@ LOOT_API unsigned int loot_get_dirty_info(loot_db db, const char * const plugin,
     if (db == nullptr || plugin == nullptr || needsCleaning == nullptr)
         return c_error(loot_error_invalid_args, "Null pointer passed.");
 
-    *needsCleaning = loot_needs_cleaning_unknown;
+    const std::shared_ptr<const MetadataSnapshot> snapshot(db->Snapshot());
+    try {
+        boost::shared_lock<boost::shared_mutex> gameLock(db->gameMutex);
+        const loot::PluginMetadata masterlistPlugin(snapshot->masterlist.FindPlugin(loot::PluginMetadata(plugin)));
+        const loot::PluginMetadata userlistPlugin(snapshot->userlist.FindPlugin(loot::PluginMetadata(plugin)));
+        gameLock.unlock();
 
-    // Is there any dirty info? Testing for applicability happens in loot_eval_lists().
-    if (!db->masterlist.FindPlugin(loot::Plugin(plugin)).DirtyInfo().empty()
-        || !db->userlist.FindPlugin(loot::Plugin(plugin)).DirtyInfo().empty()) {
-        *needsCleaning = loot_needs_cleaning_yes;
+        *needsCleaning = GetCleanliness(masterlistPlugin, userlistPlugin, GetMessages(masterlistPlugin, userlistPlugin));
+    }
+    catch (loot::error& e) {
+        return c_error(e);
+    }
+    catch (std::bad_alloc& e) {
+        return c_error(loot_error_no_mem, e.what());
+    }
+    catch (std::exception& e) {
+        return c_error(loot_error_condition_eval_fail, e.what());
     }
 
-    // Is there a message beginning with the substring "Do not clean."?
-    // This isn't a very reliable system, because if the lists have been evaluated in some language
-    // other than English, the strings will be in different languages (and the API can't tell what they'd be)
-    // and the strings may be non-standard and begin with something other than "Do not clean." anyway.
-    std::list<loot::Message> messages(db->masterlist.FindPlugin(loot::Plugin(plugin)).Messages());
+    return loot_ok;
+}
 
-    std::list<loot::Message> temp(db->userlist.FindPlugin(loot::Plugin(plugin)).Messages());
-    messages.insert(messages.end(), temp.begin(), temp.end());
+// Outputs the Bash Tag suggestions, messages and cleanliness of each of the
+// given plugins, looking each plugin up once. The output is valid until
+// loot_destroy_db is called or the calling thread next calls loot_get_plugins_info.
+LOOT_API unsigned int loot_get_plugins_info(loot_db db,
+                                            const char * const * const plugins,
+                                            const size_t numPlugins,
+                                            loot_plugin_info ** const info) {
+    if (db == nullptr || plugins == nullptr || info == nullptr)
+        return c_error(loot_error_invalid_args, "Null pointer passed.");
+    for (size_t i = 0; i < numPlugins; ++i) {
+        if (plugins[i] == nullptr)
+            return c_error(loot_error_invalid_args, "Null pointer passed.");
+    }
 
-    for (const auto& message : messages) {
-        if (boost::starts_with(message.ChooseContent(loot::Language::english).Str(), "Do not clean")) {
-            *needsCleaning = loot_needs_cleaning_no;
-            break;
+    const std::shared_ptr<const MetadataSnapshot> snapshot(db->Snapshot());
+    if (!snapshot->tagMapOutput) {
+        return c_error(loot_error_no_tag_map, "No Bash Tag map has been previously generated.");
+    }
+
+    //Initialise output.
+    *info = nullptr;
+    ThreadOutputs& outputs = db->Outputs();
+    outputs.extPluginInfo = nullptr;
+
+    if (numPlugins == 0)
+        return loot_ok;
+
+    // Everything is looked up first, so that the output can be sized and
+    // then written to one block.
+    struct PluginOutput {
+        size_t numTags_added;
+        size_t numTags_removed;
+        bool userlistModified;
+        size_t numMessages;
+        unsigned int needsCleaning;
+    };
+
+    try {
+        std::vector<PluginOutput> pluginOutputs(numPlugins);
+        std::vector<unsigned int> allTagIds;
+        std::vector<unsigned int> messageTypes;
+        std::vector<std::string> messageContents;
+        size_t stringsSize = 0;
+
+        boost::shared_lock<boost::shared_mutex> gameLock(db->gameMutex);
+        for (size_t i = 0; i < numPlugins; ++i) {
+            const loot::PluginMetadata masterlistPlugin(snapshot->masterlist.FindPlugin(loot::PluginMetadata(plugins[i])));
+            const loot::PluginMetadata userlistPlugin(snapshot->userlist.FindPlugin(loot::PluginMetadata(plugins[i])));
+            PluginOutput& output = pluginOutputs[i];
+
+            const std::shared_ptr<const PluginTagIds> tagIds(snapshot->pluginTags->Get(plugins[i], [&]() {
+                return GetTagIds(*snapshot->tags, masterlistPlugin, userlistPlugin);
+            }));
+            allTagIds.insert(allTagIds.end(), tagIds->added.begin(), tagIds->added.end());
+            allTagIds.insert(allTagIds.end(), tagIds->removed.begin(), tagIds->removed.end());
+            output.numTags_added = tagIds->added.size();
+            output.numTags_removed = tagIds->removed.size();
+            output.userlistModified = tagIds->userlistModified;
+
+            std::vector<loot::Message> messages(GetMessages(masterlistPlugin, userlistPlugin));
+            for (const auto &message : messages) {
+                messageTypes.push_back(message.Type());
+                messageContents.push_back(message.ChooseContent(loot::Language::any).Str());
+                stringsSize += messageContents.back().length() + 1;
+            }
+            output.numMessages = messages.size();
+
+            output.needsCleaning = GetCleanliness(masterlistPlugin, userlistPlugin, messages);
+        }
+        gameLock.unlock();
+
+        outputs.pluginInfoArena.Reset(ResultArena::ArraySize<loot_plugin_info>(numPlugins)
+                                  + ResultArena::ArraySize<unsigned int>(allTagIds.size())
+                                  + ResultArena::ArraySize<loot_message>(messageContents.size())
+                                  + stringsSize);
+        outputs.extPluginInfo = outputs.pluginInfoArena.Allocate<loot_plugin_info>(numPlugins);
+        unsigned int * tagIds = outputs.pluginInfoArena.Allocate<unsigned int>(allTagIds.size());
+        loot_message * messages = outputs.pluginInfoArena.Allocate<loot_message>(messageContents.size());
+
+        std::copy(allTagIds.begin(), allTagIds.end(), tagIds);
+        for (size_t i = 0; i < messageContents.size(); ++i) {
+            messages[i].type = messageTypes[i];
+            messages[i].message = outputs.pluginInfoArena.CopyString(messageContents[i]);
+        }
+
+        for (size_t i = 0; i < numPlugins; ++i) {
+            const PluginOutput& output = pluginOutputs[i];
+            loot_plugin_info& pluginInfo = outputs.extPluginInfo[i];
+
+            pluginInfo.tagIds_added = output.numTags_added == 0 ? nullptr : tagIds;
+            pluginInfo.numTags_added = output.numTags_added;
+            tagIds += output.numTags_added;
+            pluginInfo.tagIds_removed = output.numTags_removed == 0 ? nullptr : tagIds;
+            pluginInfo.numTags_removed = output.numTags_removed;
+            tagIds += output.numTags_removed;
+            pluginInfo.userlistModified = output.userlistModified;
+            pluginInfo.messages = output.numMessages == 0 ? nullptr : messages;
+            pluginInfo.numMessages = output.numMessages;
+            messages += output.numMessages;
+            pluginInfo.needsCleaning = output.needsCleaning;
         }
     }
+    catch (loot::error& e) {
+        outputs.extPluginInfo = nullptr;
+        return c_error(e);
+    }
+    catch (std::bad_alloc& e) {
+        outputs.extPluginInfo = nullptr;
+        return c_error(loot_error_no_mem, e.what());
+    }
+    catch (std::exception& e) {
+        outputs.extPluginInfo = nullptr;
+        return c_error(loot_error_condition_eval_fail, e.what());
+    }
+
+    *info = outputs.extPluginInfo;
+
+    return loot_ok;
+}
+
+// Frees the outputs of the database access functions for the calling thread.
+LOOT_API unsigned int loot_release_thread_outputs(loot_db db) {
+    if (db == nullptr)
+        return c_error(loot_error_invalid_args, "Null pointer passed.");
+
+    db->ReleaseOutputs();
 
     return loot_ok;
 }
@@ -805,30 +1364,59 @@ LOOT_API unsigned int loot_write_minimal_list(loot_db db, const char * const out
     if (boost::filesystem::exists(outputFile) && !overwrite)
         return c_error(loot_error_file_write_fail, "Output file exists but overwrite is not set to true.");
 
-    loot::Masterlist temp = db->masterlist;
-    std::unordered_set<loot::Plugin> minimalPlugins;
-    for (const auto &plugin : temp.Plugins()) {
-        loot::Plugin p(plugin.Name());
-        p.Tags(plugin.Tags());
-        p.DirtyInfo(plugin.DirtyInfo());
-        minimalPlugins.insert(p);
-    }
-
-    YAML::Emitter yout;
-    yout.SetIndent(2);
-    yout << YAML::BeginMap
-        << YAML::Key << "plugins" << YAML::Value << minimalPlugins
-        << YAML::EndMap;
+    // Entries are written as they are visited, so only the entries that
+    // are written are evaluated or copied.
+    const std::shared_ptr<const MetadataSnapshot> snapshot(db->Snapshot());
+    const auto hasMinimalData = [](const loot::PluginMetadata& plugin) {
+        return !plugin.Tags().empty() || !plugin.DirtyInfo().empty();
+    };
 
+    // Write to a temporary file first, so that an error partway through
+    // can't leave a truncated list in place of the existing one.
     boost::filesystem::path p(outputFile);
+    boost::filesystem::path tempPath(p.string() + ".tmp");
+    const auto removeTempFile = [&tempPath]() {
+        boost::system::error_code ec;
+        boost::filesystem::remove(tempPath, ec);
+    };
     try {
-        loot::ofstream out(p);
+        loot::ofstream out(tempPath);
         if (out.fail())
             return c_error(loot_error_invalid_args, "Couldn't open output file.");
-        out << yout.c_str();
+
+        YAML::Emitter yout(out);
+        yout.SetIndent(2);
+        yout << YAML::BeginMap
+            << YAML::Key << "plugins" << YAML::Value << YAML::BeginSeq;
+        {
+            boost::shared_lock<boost::shared_mutex> gameLock(db->gameMutex);
+            snapshot->masterlist.VisitPlugins(hasMinimalData, [&](const loot::PluginMetadata& plugin) {
+                // Evaluation may have removed the entry's tags and dirty info.
+                if (!hasMinimalData(plugin))
+                    return;
+
+                loot::PluginMetadata minimal(plugin.Name());
+                minimal.Tags(plugin.Tags());
+                minimal.DirtyInfo(plugin.DirtyInfo());
+                yout << minimal;
+            });
+        }
+        yout << YAML::EndSeq << YAML::EndMap;
+
         out.close();
+        if (out.fail()) {
+            removeTempFile();
+            return c_error(loot_error_file_write_fail, "Couldn't write output file.");
+        }
+
+        boost::filesystem::rename(tempPath, p);
+    }
+    catch (loot::error& e) {
+        removeTempFile();
+        return c_error(e);
     }
     catch (std::exception& e) {
+        removeTempFile();
         return c_error(loot_error_file_write_fail, e.what());
     }
 
@@ -53,6 +53,7 @@ namespace loot {
         static const unsigned int git_error = 12;
         static const unsigned int windows_error = 13;
         static const unsigned int sorting_error = 14;
+        static const unsigned int cancelled = 15;
     private:
         unsigned int _code;
         std::string _what;
@@ -0,0 +1,213 @@
+/*  LOOT
+
+    A load order optimisation tool for Oblivion, Skyrim, Fallout 3 and
+    Fallout: New Vegas.
+
+    Copyright (C) 2012-2015    WrinklyNinja
+
+    This file is part of LOOT.
+
+    LOOT is free software: you can redistribute
+    it and/or modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    LOOT is distributed in the hope that it will
+    be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with LOOT.  If not, see
+    <http://www.gnu.org/licenses/>.
+    */
+
+#include "data_directory_snapshot.h"
+#include "sharded_cache.h"
+
+#include <boost/log/trivial.hpp>
+
+#ifdef _WIN32
+#   ifndef UNICODE
+#       define UNICODE
+#   endif
+#   ifndef _UNICODE
+#      define _UNICODE
+#   endif
+#   include "windows.h"
+#else
+#   include <sys/stat.h>
+#endif
+
+using namespace std;
+
+namespace fs = boost::filesystem;
+
+namespace loot {
+#ifdef _WIN32
+    namespace {
+        // Converts a FILETIME, which counts 100ns intervals since 1601.
+        time_t ToTime(const FILETIME& fileTime) {
+            ULARGE_INTEGER time;
+            time.LowPart = fileTime.dwLowDateTime;
+            time.HighPart = fileTime.dwHighDateTime;
+            return static_cast<time_t>((time.QuadPart - 116444736000000000ULL) / 10000000ULL);
+        }
+    }
+#endif
+
+    PathStamp StampPath(const boost::filesystem::path& path) {
+        // Get the modification time and size from one call.
+#ifdef _WIN32
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        if (!GetFileAttributesExW(path.wstring().c_str(), GetFileExInfoStandard, &data))
+            return PathStamp();
+
+        const bool isDirectory = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+        const uintmax_t size = isDirectory ? 0 : (static_cast<uintmax_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+        return PathStamp(ToTime(data.ftLastWriteTime), size);
+#else
+        struct stat status;
+        if (::stat(path.c_str(), &status) != 0)
+            return PathStamp();
+
+        const uintmax_t size = S_ISREG(status.st_mode) ? static_cast<uintmax_t>(status.st_size) : 0;
+        return PathStamp(status.st_mtime, size);
+#endif
+    }
+
+    const size_t DataDirectorySnapshot::npos;
+
+    DataDirectorySnapshot::DataDirectorySnapshot() : hasSnapshot(false) {}
+
+    DataDirectorySnapshot::DataDirectorySnapshot(const DataDirectorySnapshot& snapshot)
+        : hasSnapshot(snapshot.hasSnapshot),
+        directory(snapshot.directory),
+        entries(snapshot.entries),
+        filenames(snapshot.filenames),
+        index(snapshot.index) {
+        std::lock_guard<std::mutex> guard(snapshot.stampsMutex);
+        stamps = snapshot.stamps;
+        stamped = snapshot.stamped;
+    }
+
+    DataDirectorySnapshot& DataDirectorySnapshot::operator=(const DataDirectorySnapshot& snapshot) {
+        if (this == &snapshot)
+            return *this;
+
+        hasSnapshot = snapshot.hasSnapshot;
+        directory = snapshot.directory;
+        entries = snapshot.entries;
+        filenames = snapshot.filenames;
+        index = snapshot.index;
+
+        std::lock(stampsMutex, snapshot.stampsMutex);
+        std::lock_guard<std::mutex> guard(stampsMutex, std::adopt_lock);
+        std::lock_guard<std::mutex> otherGuard(snapshot.stampsMutex, std::adopt_lock);
+        stamps = snapshot.stamps;
+        stamped = snapshot.stamped;
+
+        return *this;
+    }
+
+    void DataDirectorySnapshot::Refresh(const boost::filesystem::path& directory) {
+        Clear();
+
+        BOOST_LOG_TRIVIAL(trace) << "Taking a snapshot of the contents of " << directory;
+#ifdef _WIN32
+        // The directory listing already gives each entry's modification time
+        // and size, so nothing needs to be opened to stamp the entries.
+        WIN32_FIND_DATAW findData;
+        HANDLE findHandle = FindFirstFileExW((directory / "*").wstring().c_str(), FindExInfoStandard, &findData, FindExSearchNameMatch, NULL, 0);
+        if (findHandle == INVALID_HANDLE_VALUE)
+            throw fs::filesystem_error("Could not list directory", directory, boost::system::error_code(GetLastError(), boost::system::system_category()));
+
+        do {
+            const wstring filename(findData.cFileName);
+            if (filename == L"." || filename == L"..")
+                continue;
+
+            const bool isDirectory = (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+            const uintmax_t size = isDirectory ? 0 : (static_cast<uintmax_t>(findData.nFileSizeHigh) << 32) | findData.nFileSizeLow;
+
+            AddEntry(fs::directory_entry(directory / filename, fs::file_status(isDirectory ? fs::directory_file : fs::regular_file)),
+                     PathStamp(ToTime(findData.ftLastWriteTime), size), true);
+        } while (FindNextFileW(findHandle, &findData));
+
+        const DWORD lastError = GetLastError();
+        FindClose(findHandle);
+        if (lastError != ERROR_NO_MORE_FILES) {
+            Clear();
+            throw fs::filesystem_error("Could not list directory", directory, boost::system::error_code(lastError, boost::system::system_category()));
+        }
+#else
+        // The listing doesn't give stamps, so entries are stamped when their
+        // stamps are first asked for.
+        for (fs::directory_iterator it(directory); it != fs::directory_iterator(); ++it) {
+            AddEntry(*it, PathStamp(), false);
+        }
+#endif
+
+        this->directory = directory;
+        hasSnapshot = true;
+    }
+
+    void DataDirectorySnapshot::Clear() {
+        hasSnapshot = false;
+        directory.clear();
+        entries.clear();
+        filenames.clear();
+        index.clear();
+
+        std::lock_guard<std::mutex> guard(stampsMutex);
+        stamps.clear();
+        stamped.clear();
+    }
+
+    bool DataDirectorySnapshot::Covers(const boost::filesystem::path& directory) const {
+        return hasSnapshot && directory == this->directory;
+    }
+
+    std::pair<bool, bool> DataDirectorySnapshot::Exists(const boost::filesystem::path& directory, const std::string& path) const {
+        auto found = Find(directory, path);
+        return pair<bool, bool>(found.first != npos, found.second);
+    }
+
+    std::pair<size_t, bool> DataDirectorySnapshot::Find(const boost::filesystem::path& directory, const std::string& path) const {
+        if (!Covers(directory)
+            || path.empty()
+            || path == "."
+            || path == ".."
+            || path.find_first_of("/\\") != string::npos)
+            return pair<size_t, bool>(npos, false);
+
+        auto it = index.find(CacheKey(path, false).Folded());
+        return pair<size_t, bool>(it == index.end() ? npos : it->second, true);
+    }
+
+    const std::vector<boost::filesystem::directory_entry>& DataDirectorySnapshot::Entries() const {
+        return entries;
+    }
+
+    const std::vector<std::string>& DataDirectorySnapshot::Filenames() const {
+        return filenames;
+    }
+
+    PathStamp DataDirectorySnapshot::Stamp(size_t i) const {
+        std::lock_guard<std::mutex> guard(stampsMutex);
+        if (!stamped.at(i)) {
+            stamps[i] = StampPath(entries[i].path());
+            stamped[i] = true;
+        }
+        return stamps[i];
+    }
+
+    void DataDirectorySnapshot::AddEntry(const boost::filesystem::directory_entry& entry, const PathStamp& stamp, bool isStamped) {
+        string filename = entry.path().filename().string();
+        index.insert(pair<string, size_t>(CacheKey(filename, false).Folded(), entries.size()));
+        filenames.push_back(filename);
+        entries.push_back(entry);
+        stamps.push_back(stamp);
+        stamped.push_back(isStamped);
+    }
+}
@@ -0,0 +1,99 @@
+/*  LOOT
+
+    A load order optimisation tool for Oblivion, Skyrim, Fallout 3 and
+    Fallout: New Vegas.
+
+    Copyright (C) 2012-2015    WrinklyNinja
+
+    This file is part of LOOT.
+
+    LOOT is free software: you can redistribute
+    it and/or modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    LOOT is distributed in the hope that it will
+    be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with LOOT.  If not, see
+    <http://www.gnu.org/licenses/>.
+    */
+#ifndef __LOOT_GAME_DATA_DIRECTORY_SNAPSHOT__
+#define __LOOT_GAME_DATA_DIRECTORY_SNAPSHOT__
+
+#include "game_cache.h"
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+namespace loot {
+    // Gets the current stamp of a path on the filesystem, using a single
+    // call. Directories have a size of 0.
+    PathStamp StampPath(const boost::filesystem::path& path);
+
+    // A listing of a directory's entries and their stamps, so that
+    // existence checks for files in it and changes to them can be answered
+    // without touching the filesystem. The snapshot may be queried from
+    // multiple threads, but must not be refreshed while it is being queried.
+    class DataDirectorySnapshot {
+    public:
+        DataDirectorySnapshot();
+        DataDirectorySnapshot(const DataDirectorySnapshot& snapshot);
+
+        DataDirectorySnapshot& operator=(const DataDirectorySnapshot& snapshot);
+
+        // Lists the given directory, replacing any previous snapshot.
+        void Refresh(const boost::filesystem::path& directory);
+        void Clear();
+
+        // Checks if a snapshot has been taken of the given directory.
+        bool Covers(const boost::filesystem::path& directory) const;
+
+        // Checks case-insensitively if the path exists in the given
+        // directory. Returns false for second bool if the snapshot can't
+        // answer, because it doesn't cover the directory or the path is
+        // not a filename in the directory itself.
+        std::pair<bool, bool> Exists(const boost::filesystem::path& directory, const std::string& path) const;
+
+        // Finds the path's entry case-insensitively, giving its index in
+        // the vectors below, or npos if it doesn't exist. Returns false for
+        // second bool if the snapshot can't answer, as for Exists().
+        std::pair<size_t, bool> Find(const boost::filesystem::path& directory, const std::string& path) const;
+
+        static const size_t npos = static_cast<size_t>(-1);
+
+        // The directory's entries and their filenames, in the same order.
+        const std::vector<boost::filesystem::directory_entry>& Entries() const;
+        const std::vector<std::string>& Filenames() const;
+
+        // Gets the stamp of the entry at the given index. On Windows the
+        // listing gives every entry's stamp. Elsewhere an entry is stamped
+        // the first time its stamp is asked for after a refresh, so only
+        // the entries whose stamps are used are read.
+        PathStamp Stamp(size_t i) const;
+    private:
+        void AddEntry(const boost::filesystem::directory_entry& entry, const PathStamp& stamp, bool isStamped);
+
+        bool hasSnapshot;
+        boost::filesystem::path directory;
+        std::vector<boost::filesystem::directory_entry> entries;
+        std::vector<std::string> filenames;
+        // Maps folded filenames to their entries' indices.
+        std::unordered_map<std::string, size_t> index;
+
+        // Filled in as stamps are asked for, under the mutex.
+        mutable std::mutex stampsMutex;
+        mutable std::vector<PathStamp> stamps;
+        mutable std::vector<bool> stamped;
+    };
+}
+
+#endif
@@ -29,6 +29,7 @@
 #include "../helpers/streams.h"
 
 #include <thread>
+#include <unordered_set>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/locale.hpp>
@@ -94,13 +95,10 @@ namespace loot {
         if (!loadorder.empty()) {
             time_t lastTime = 0;
             for (const auto &pluginName : loadorder) {
-                fs::path filepath = DataPath() / pluginName;
-                if (!fs::exists(filepath)) {
-                    if (fs::exists(filepath.string() + ".ghost"))
-                        filepath += ".ghost";
-                    else
-                        continue;
-                }
+                if (!DataFileExists(pluginName))
+                    continue;
+
+                fs::path filepath = DataFilePath(pluginName);
 
                 time_t thisTime = fs::last_write_time(filepath);
                 BOOST_LOG_TRIVIAL(info) << "Current timestamp for \"" << filepath.filename().string() << "\": " << thisTime;
@@ -117,37 +115,93 @@ namespace loot {
         }
     }
 
-    void Game::LoadPlugins(bool headersOnly) {
+    void Game::LoadPlugins(bool headersOnly, const CancellationToken& cancellation) {
         uintmax_t meanFileSize = 0;
         multimap<uintmax_t, string> sizeMap;
+        unordered_map<string, LoadedPluginStamp> newStamps;
+        unordered_set<string> installed;
+        size_t reused = 0;
 
         // First find out how many plugins there are, and their sizes.
+        // Refreshing the snapshot also discards cached results for any
+        // plugins that have changed.
         BOOST_LOG_TRIVIAL(trace) << "Scanning for plugins in " << this->DataPath();
-        for (fs::directory_iterator it(this->DataPath()); it != fs::directory_iterator(); ++it) {
-            if (fs::is_regular_file(it->status()) && Plugin(it->path().filename().string()).IsValid(*this)) {
-                Plugin temp(it->path().filename().string());
+        InvalidateChangedPaths();
+        for (size_t i = 0; i < dataSnapshot.Entries().size(); ++i) {
+            const fs::directory_entry& entry = dataSnapshot.Entries()[i];
+            if (fs::is_regular_file(entry.status()) && Plugin(entry.path().filename().string()).IsValid(*this)) {
+                Plugin temp(entry.path().filename().string());
                 BOOST_LOG_TRIVIAL(info) << "Found plugin: " << temp.Name();
 
-                uintmax_t fileSize = fs::file_size(it->path());
-                meanFileSize += fileSize;
-
                 //Insert the lowercased name as a key for case-insensitive matching.
                 string name = boost::locale::to_lower(temp.Name());
-                plugins.insert(pair<string, Plugin>(name, temp));
+                installed.insert(name);
+
+                const PathStamp pathStamp = dataSnapshot.Stamp(i);
+                uintmax_t fileSize = pathStamp.size;
+                LoadedPluginStamp stamp = { pathStamp, headersOnly };
+
+                // Keep the existing data if the file hasn't changed since it
+                // was loaded, and at least as much of it was loaded.
+                auto loaded = loadedPluginStamps.find(name);
+                auto pluginIt = plugins.find(name);
+                if (loaded != loadedPluginStamps.end() && pluginIt != plugins.end()
+                    && loaded->second.stamp == stamp.stamp
+                    && (headersOnly || !loaded->second.headerOnly)
+                    && pluginIt->second.Name() == temp.Name()) {
+                    BOOST_LOG_TRIVIAL(trace) << "Reusing the loaded data for " << temp.Name();
+                    if (!loaded->second.headerOnly) {
+                        // The CRC may have been discarded from the cache.
+                        TrackPath(temp.Name());
+                        CacheCrc(temp.Name(), pluginIt->second.Crc());
+                    }
+                    ++reused;
+                    continue;
+                }
+
+                meanFileSize += fileSize;
+
+                // Forget the old stamp until the plugin is reloaded, in case
+                // loading is cancelled.
+                loadedPluginStamps.erase(name);
+                newStamps.insert(pair<string, LoadedPluginStamp>(name, stamp));
+                plugins[name] = temp;
                 sizeMap.insert(pair<uintmax_t, string>(fileSize, name));
             }
         }
+
+        // Remove any plugins that are no longer installed.
+        for (auto it = plugins.begin(); it != plugins.end();) {
+            if (installed.count(it->first) == 0) {
+                BOOST_LOG_TRIVIAL(info) << "Plugin is no longer installed: " << it->second.Name();
+                loadedPluginStamps.erase(it->first);
+                it = plugins.erase(it);
+            }
+            else
+                ++it;
+        }
+
+        // The plugins to reload have been reset, so are no longer loaded.
+        if (!sizeMap.empty())
+            _pluginsFullyLoaded = false;
+        cancellation.ThrowIfCancelled();
+
+        if (sizeMap.empty()) {
+            BOOST_LOG_TRIVIAL(info) << "Reused the loaded data for all " << reused << " plugins.";
+            _pluginsFullyLoaded = AreLoadedPluginsFull(headersOnly);
+            return;
+        }
         meanFileSize /= sizeMap.size();  //Rounding error, but not important.
 
         // Get the number of threads to use.
         // hardware_concurrency() may be zero, if so then use only one thread.
-        size_t threadsToUse = std::min((size_t)thread::hardware_concurrency(), plugins.size());
+        size_t threadsToUse = std::min((size_t)thread::hardware_concurrency(), sizeMap.size());
         threadsToUse = std::max(threadsToUse, (size_t)1);
 
         // Divide the plugins up by thread.
-        unsigned int pluginsPerThread = ceil((double)plugins.size() / threadsToUse);
+        unsigned int pluginsPerThread = ceil((double)sizeMap.size() / threadsToUse);
         vector<vector<unordered_map<string, Plugin>::iterator>> pluginGroups(threadsToUse);
-        BOOST_LOG_TRIVIAL(info) << "Loading " << plugins.size() << " plugins using " << threadsToUse << " threads, with up to " << pluginsPerThread << " plugins per thread.";
+        BOOST_LOG_TRIVIAL(info) << "Loading " << sizeMap.size() << " plugins using " << threadsToUse << " threads, with up to " << pluginsPerThread << " plugins per thread. Reusing the loaded data for " << reused << " plugins.";
 
         // The plugins should be split between the threads so that the data
         // load is as evenly spread as possible.
@@ -160,13 +214,19 @@ namespace loot {
             ++currentGroup;
         }
 
-        // Load the plugins.
+        // Load the plugins. Each thread records the plugins that it failed
+        // to load, so that they aren't stamped as loaded.
         BOOST_LOG_TRIVIAL(trace) << "Starting plugin loading.";
+        vector<vector<string>> failedGroups(threadsToUse);
         vector<thread> threads;
         while (threads.size() < threadsToUse) {
             vector<unordered_map<string, Plugin>::iterator>& pluginGroup = pluginGroups[threads.size()];
-            threads.push_back(thread([this, &pluginGroup, headersOnly]() {
+            vector<string>& failed = failedGroups[threads.size()];
+            threads.push_back(thread([this, &pluginGroup, &failed, headersOnly, &cancellation]() {
                 for (auto it : pluginGroup) {
+                    if (cancellation.IsCancelled())
+                        break;
+
                     BOOST_LOG_TRIVIAL(trace) << "Loading " << it->second.Name();
                     try {
                         it->second = Plugin(*this, it->second.Name(), headersOnly);
@@ -174,8 +234,9 @@ namespace loot {
                     catch (exception &e) {
                         BOOST_LOG_TRIVIAL(error) << it->second.Name() << ": Exception occurred: " << e.what();
                         Plugin p(it->second.Name());
-                        p.Messages(list<Message>(1, Message(Message::error, lc::translate("An exception occurred while loading this plugin. Details:").str() + " " + e.what())));
+                        p.Messages(vector<Message>(1, Message(Message::error, lc::translate("An exception occurred while loading this plugin. Details:").str() + " " + e.what())));
                         it->second = p;
+                        failed.push_back(it->first);
                     }
                 }
             }));
@@ -187,13 +248,175 @@ namespace loot {
                 thread.join();
         }
 
-        _pluginsFullyLoaded = !headersOnly;
+        if (cancellation.IsCancelled()) {
+            BOOST_LOG_TRIVIAL(info) << "Plugin loading was cancelled.";
+            cancellation.ThrowIfCancelled();
+        }
+
+        // Plugins that failed to load are tried again next time.
+        for (const auto& failed : failedGroups) {
+            for (const auto& name : failed)
+                newStamps.erase(name);
+        }
+        loadedPluginStamps.insert(newStamps.begin(), newStamps.end());
+        _pluginsFullyLoaded = AreLoadedPluginsFull(headersOnly);
     }
 
     bool Game::ArePluginsFullyLoaded() const {
         return _pluginsFullyLoaded;
     }
 
+    void Game::ClearLoadedPluginStamps() {
+        loadedPluginStamps.clear();
+    }
+
+    bool Game::AreLoadedPluginsFull(bool headersOnly) const {
+        // Plugins that failed to load aren't stamped, so if there are any,
+        // or if there are no plugins at all, go by what was asked for.
+        if (headersOnly && (loadedPluginStamps.empty() || loadedPluginStamps.size() < plugins.size()))
+            return false;
+
+        for (const auto& loaded : loadedPluginStamps) {
+            if (loaded.second.headerOnly)
+                return false;
+        }
+        return true;
+    }
+
+    void Game::EvalConditionProbes(const std::set<std::string>& probes) {
+        if (probes.empty())
+            return;
+
+        // hardware_concurrency() may be zero, if so then use only one thread.
+        size_t threadsToUse = std::min((size_t)thread::hardware_concurrency(), probes.size());
+        threadsToUse = std::max(threadsToUse, (size_t)1);
+
+        // Regex probes for the same directory are given to the same thread,
+        // so that the directory is only listed once.
+        vector<vector<ConditionalMetadata>> probeGroups(threadsToUse);
+        size_t currentGroup = 0;
+        for (const auto& probe : probes) {
+            if (boost::starts_with(probe, "regex(\"")) {
+                string regex = probe.substr(7, probe.length() - 9);
+                size_t slashPos = regex.rfind('/');
+                size_t backslashPos = regex.rfind("\\\\");
+                size_t pos = 0;
+                if (slashPos != string::npos)
+                    pos = slashPos;
+                if (backslashPos != string::npos && (slashPos == string::npos || backslashPos > slashPos))
+                    pos = backslashPos;
+
+                size_t group = hash<string>()(boost::locale::to_lower(regex.substr(0, pos))) % threadsToUse;
+                probeGroups[group].push_back(ConditionalMetadata(probe));
+                continue;
+            }
+
+            if (currentGroup == threadsToUse)
+                currentGroup = 0;
+            probeGroups[currentGroup].push_back(ConditionalMetadata(probe));
+            ++currentGroup;
+        }
+
+        BOOST_LOG_TRIVIAL(debug) << "Evaluating " << probes.size() << " condition probes using " << threadsToUse << " threads.";
+        vector<thread> threads;
+        while (threads.size() < threadsToUse) {
+            vector<ConditionalMetadata>& probeGroup = probeGroups[threads.size()];
+            threads.push_back(thread([this, &probeGroup]() {
+                for (const auto& probe : probeGroup) {
+                    try {
+                        probe.EvalCondition(*this);
+                    }
+                    catch (exception &e) {
+                        BOOST_LOG_TRIVIAL(debug) << "Failed to evaluate condition probe \"" << probe.Condition() << "\": " << e.what();
+                    }
+                }
+            }));
+        }
+
+        for (auto& thread : threads) {
+            if (thread.joinable())
+                thread.join();
+        }
+    }
+
+    void Game::RefreshDataSnapshot() {
+        dataSnapshot.Refresh(DataPath());
+    }
+
+    const DataDirectorySnapshot& Game::DataSnapshot() const {
+        return dataSnapshot;
+    }
+
+    bool Game::DataFileExists(const std::string& file) const {
+        bool isPlugin = boost::iends_with(file, ".esp") || boost::iends_with(file, ".esm");
+        fs::path dataPath = DataPath();
+
+        auto exists = dataSnapshot.Exists(dataPath, file);
+        if (exists.second) {
+            return exists.first || (isPlugin && dataSnapshot.Exists(dataPath, file + ".ghost").first);
+        }
+
+        return fs::exists(dataPath / file) || (isPlugin && fs::exists(dataPath / (file + ".ghost")));
+    }
+
+    boost::filesystem::path Game::DataFilePath(const std::string& file) const {
+        fs::path dataPath = DataPath();
+        bool isPlugin = boost::iends_with(file, ".esp") || boost::iends_with(file, ".esm");
+
+        // The snapshot matches case-insensitively, so the path is built from
+        // the filename it found, in case the filesystem is case-sensitive.
+        auto found = dataSnapshot.Find(dataPath, file);
+        if (found.second) {
+            if (found.first == DataDirectorySnapshot::npos && isPlugin)
+                found = dataSnapshot.Find(dataPath, file + ".ghost");
+            if (found.first != DataDirectorySnapshot::npos)
+                return dataPath / dataSnapshot.Filenames()[found.first];
+        }
+        else if (isPlugin && !fs::exists(dataPath / file) && fs::exists(dataPath / (file + ".ghost")))
+            return dataPath / (file + ".ghost");
+
+        return dataPath / file;
+    }
+
+    PathStamp Game::GetPathStamp(const std::string& path) const {
+        fs::path dataPath = DataPath();
+        bool isPlugin = boost::iends_with(path, ".esp") || boost::iends_with(path, ".esm");
+
+        // Files in the Data folder itself are stamped from the snapshot.
+        auto found = dataSnapshot.Find(dataPath, path);
+        if (found.second) {
+            if (found.first == DataDirectorySnapshot::npos && isPlugin)
+                found = dataSnapshot.Find(dataPath, path + ".ghost");
+            if (found.first == DataDirectorySnapshot::npos)
+                return PathStamp();
+            return dataSnapshot.Stamp(found.first);
+        }
+
+        fs::path filepath = dataPath / path;
+        if (isPlugin && !fs::exists(filepath))
+            filepath += ".ghost";
+
+        return StampPath(filepath);
+    }
+
+    void Game::TrackPath(const std::string& path) {
+        if (!GetCachedPathStamp(path).second)
+            CachePathStamp(path, GetPathStamp(path));
+    }
+
+    void Game::InvalidateChangedPaths() {
+        RefreshDataSnapshot();
+
+        size_t changed = 0;
+        for (const auto& stamp : GetCachedPathStamps()) {
+            if (GetPathStamp(stamp.first) != stamp.second) {
+                InvalidatePath(stamp.first);
+                ++changed;
+            }
+        }
+        BOOST_LOG_TRIVIAL(debug) << "Found " << changed << " changed paths that cached results depend on.";
+    }
+
     std::list<Game> ToGames(const std::list<GameSettings>& settings) {
         return list<Game>(settings.begin(), settings.end());
     }
@@ -25,13 +25,16 @@
 #ifndef __LOOT_GAME__
 #define __LOOT_GAME__
 
+#include "data_directory_snapshot.h"
 #include "game_cache.h"
 #include "game_settings.h"
 #include "load_order_handler.h"
+#include "../helpers/cancellation.h"
 #include "../plugin/plugin.h"
 #include "../metadata_list.h"
 #include "../masterlist.h"
 
+#include <set>
 #include <string>
 #include <unordered_map>
 
@@ -50,15 +53,71 @@ namespace loot {
         void RefreshActivePluginsList();
         void RedatePlugins();  //Change timestamps to match load order (Skyrim only).
 
-        void LoadPlugins(bool headersOnly);  //Loads all installed plugins.
+        //Loads all installed plugins. Also refreshes the Data folder snapshot
+        //and invalidates cached results for changed paths.
+        //Plugins that were already loaded to at least the requested depth are
+        //kept if their size and modification time are unchanged, and plugins
+        //that are no longer installed are removed.
+        //If cancelled, stops loading and throws, leaving the plugins partially loaded.
+        void LoadPlugins(bool headersOnly, const CancellationToken& cancellation = CancellationToken());
         bool ArePluginsFullyLoaded() const;  // Checks if the game's plugins have already been loaded.
 
+        // Makes the next LoadPlugins() call reload every plugin, for when
+        // plugins may have changed without their size or modification time
+        // changing.
+        void ClearLoadedPluginStamps();
+
+        // Evaluates the given condition probes across multiple threads, so
+        // that their results are cached before the conditions that contain
+        // them are evaluated. Errors are left for that later evaluation.
+        void EvalConditionProbes(const std::set<std::string>& probes);
+
+        // Lists the Data folder, so that existence checks for files in it
+        // are answered from memory until the next refresh.
+        void RefreshDataSnapshot();
+        const DataDirectorySnapshot& DataSnapshot() const;
+
+        // Checks if a file exists in the Data folder. Ghosted copies of .esp
+        // and .esm files also count. Files in subfolders, or any files if no
+        // snapshot has been taken, are checked on the filesystem.
+        bool DataFileExists(const std::string& file) const;
+
+        // Gets the path to a file in the Data folder, or to its ghosted copy
+        // if it is a plugin that is only installed ghosted. Files found in
+        // the snapshot are given with their names' case on disk.
+        boost::filesystem::path DataFilePath(const std::string& file) const;
+
+        // Gets the current stamp of a path relative to the Data folder.
+        // Ghosted plugins are stamped if their unghosted path is missing.
+        // Files in the snapshot keep the stamp they were first given after
+        // it was taken, and other paths are stamped from the filesystem.
+        PathStamp GetPathStamp(const std::string& path) const;
+
+        // Records the path's current stamp if it doesn't already have one,
+        // so that results depending on it can be invalidated when it changes.
+        void TrackPath(const std::string& path);
+
+        // Refreshes the Data folder snapshot, then invalidates cached results
+        // that depend on paths which have changed since they were tracked.
+        void InvalidateChangedPaths();
+
         //Plugin data and metadata lists.
         Masterlist masterlist;
         MetadataList userlist;
         std::unordered_map<std::string, Plugin> plugins;  //Map so that plugin data can be edited.
     private:
+        // The stamp of each plugin's file when it was loaded, and whether
+        // only its header was loaded. Keyed by lowercased plugin name.
+        struct LoadedPluginStamp {
+            PathStamp stamp;
+            bool headerOnly;
+        };
+
         bool _pluginsFullyLoaded;
+        DataDirectorySnapshot dataSnapshot;
+        std::unordered_map<std::string, LoadedPluginStamp> loadedPluginStamps;
+
+        bool AreLoadedPluginsFull(bool headersOnly) const;
     };
 
     std::list<Game> ToGames(const std::list<GameSettings>& settings);
@@ -40,68 +40,249 @@ namespace fs = boost::filesystem;
 namespace lc = boost::locale;
 
 namespace loot {
-    GameCache::GameCache() {}
+    PathStamp::PathStamp() : modificationTime(-1), size(0) {}
+
+    PathStamp::PathStamp(std::time_t modificationTime, uintmax_t size) : modificationTime(modificationTime), size(size) {}
+
+    bool PathStamp::operator == (const PathStamp& rhs) const {
+        return modificationTime == rhs.modificationTime && size == rhs.size;
+    }
+
+    bool PathStamp::operator != (const PathStamp& rhs) const {
+        return !(*this == rhs);
+    }
+
+    GameCache::GameCache()
+        : conditionCache(false),
+        crcCache(true),
+        activePlugins(false),
+        fileCache(true),
+        regexCache(false, true),
+        versionCache(true),
+        directoryCache(true),
+        pathStamps(true) {}
+
     GameCache::GameCache(const GameCache& cache)
         : conditionCache(cache.conditionCache),
         crcCache(cache.crcCache),
-        activePlugins(cache.activePlugins) {}
+        activePlugins(cache.activePlugins),
+        fileCache(cache.fileCache),
+        regexCache(cache.regexCache),
+        versionCache(cache.versionCache),
+        directoryCache(cache.directoryCache),
+        pathStamps(cache.pathStamps) {
+        std::lock_guard<std::mutex> guard(cache.mutex);
+        pathDependents = cache.pathDependents;
+        activeDependents = cache.activeDependents;
+        regexDirectories = cache.regexDirectories;
+    }
 
     GameCache& GameCache::operator=(const GameCache& cache) {
+        if (this == &cache)
+            return *this;
+
         conditionCache = cache.conditionCache;
         crcCache = cache.crcCache;
         activePlugins = cache.activePlugins;
+        fileCache = cache.fileCache;
+        regexCache = cache.regexCache;
+        versionCache = cache.versionCache;
+        directoryCache = cache.directoryCache;
+        pathStamps = cache.pathStamps;
+
+        std::lock(mutex, cache.mutex);
+        std::lock_guard<std::mutex> guard(mutex, std::adopt_lock);
+        std::lock_guard<std::mutex> otherGuard(cache.mutex, std::adopt_lock);
+        pathDependents = cache.pathDependents;
+        activeDependents = cache.activeDependents;
+        regexDirectories = cache.regexDirectories;
 
         return *this;
     }
 
     void GameCache::CacheCrc(const std::string& plugin, uint32_t crc) {
-        std::lock_guard<std::mutex> guard(mutex);
-        crcCache.insert(pair<string, uint32_t>(boost::locale::to_lower(plugin), crc));
+        crcCache.Insert(plugin, crc);
     }
 
-    void GameCache::CacheCondition(const std::string& condition, bool result) {
+    void GameCache::CacheCondition(const std::string& condition, bool result, const CacheDependencies& dependencies) {
+        if (dependencies.paths.empty() && dependencies.activePlugins.empty()) {
+            conditionCache.Insert(condition, result);
+            return;
+        }
+
+        // The dependencies and the result are recorded under the same lock
+        // that invalidation takes, so an invalidation either runs before
+        // both or sees both.
+        string key = CacheKey(condition, false).Folded();
+
         std::lock_guard<std::mutex> guard(mutex);
-        conditionCache.insert(pair<string, bool>(boost::locale::to_lower(condition), result));
+        for (const auto& path : dependencies.paths) {
+            pathDependents[CacheKey(path, true).Folded()].insert(key);
+        }
+        for (const auto& plugin : dependencies.activePlugins) {
+            activeDependents[CacheKey(plugin, false).Folded()].insert(key);
+        }
+        conditionCache.Insert(condition, result);
     }
 
     void GameCache::CacheActivePlugins(const std::unordered_set<std::string>& plugins) {
         std::lock_guard<std::mutex> guard(mutex);
-        activePlugins = plugins;
+
+        unordered_set<string> foldedPlugins;
+        for (const auto& plugin : plugins) {
+            foldedPlugins.insert(CacheKey(plugin, false).Folded());
+        }
+
+        vector<string> changedPlugins;
+        activePlugins.ForEach([&](const std::string& plugin, bool) {
+            if (foldedPlugins.find(plugin) == foldedPlugins.end())
+                changedPlugins.push_back(plugin);
+        });
+        for (const auto& plugin : foldedPlugins) {
+            if (!activePlugins.Find(plugin).second)
+                changedPlugins.push_back(plugin);
+        }
+
+        for (const auto& plugin : changedPlugins) {
+            InvalidateDependents(activeDependents, plugin);
+        }
+
+        activePlugins.Clear();
+        for (const auto& plugin : foldedPlugins) {
+            activePlugins.Insert(plugin, true);
+        }
     }
 
-    uint32_t GameCache::GetCachedCrc(const std::string& plugin) const {
+    void GameCache::CacheFileExists(const std::string& file, bool exists) {
+        fileCache.Insert(file, exists);
+    }
+
+    void GameCache::CacheRegexMatches(const std::string& regex, const std::string& directory, size_t count) {
         std::lock_guard<std::mutex> guard(mutex);
+        regexDirectories[CacheKey(directory, true).Folded()].insert(CacheKey(regex, false, true).Folded());
+        regexCache.Insert(regex, count);
+    }
 
-        auto it = crcCache.find(boost::locale::to_lower(plugin));
+    void GameCache::CacheVersion(const std::string& file, const std::string& version) {
+        versionCache.Insert(file, version);
+    }
 
-        if (it != crcCache.end())
-            return it->second;
-        else
-            return 0;
+    void GameCache::CacheDirectoryListing(const std::string& directory, const std::shared_ptr<const std::vector<std::string>>& filenames) {
+        directoryCache.Insert(directory, filenames);
+    }
+
+    void GameCache::CachePathStamp(const std::string& path, const PathStamp& stamp) {
+        pathStamps.Insert(path, pair<string, PathStamp>(path, stamp));
+    }
+
+    uint32_t GameCache::GetCachedCrc(const std::string& plugin) const {
+        return crcCache.Find(plugin).first;
     }
 
     std::pair<bool, bool> GameCache::GetCachedCondition(const std::string& condition) const {
+        return conditionCache.Find(condition);
+    }
+
+    bool GameCache::IsPluginActive(const std::string& plugin) const {
+        return activePlugins.Find(plugin).second;
+    }
+
+    std::pair<bool, bool> GameCache::GetCachedFileExists(const std::string& file) const {
+        return fileCache.Find(file);
+    }
+
+    std::pair<size_t, bool> GameCache::GetCachedRegexMatches(const std::string& regex) const {
+        return regexCache.Find(regex);
+    }
+
+    std::pair<std::string, bool> GameCache::GetCachedVersion(const std::string& file) const {
+        return versionCache.Find(file);
+    }
+
+    std::pair<std::shared_ptr<const std::vector<std::string>>, bool> GameCache::GetCachedDirectoryListing(const std::string& directory) const {
+        return directoryCache.Find(directory);
+    }
+
+    std::pair<PathStamp, bool> GameCache::GetCachedPathStamp(const std::string& path) const {
+        auto stamp = pathStamps.Find(path);
+        return std::pair<PathStamp, bool>(stamp.first.second, stamp.second);
+    }
+
+    std::unordered_map<std::string, PathStamp> GameCache::GetCachedPathStamps() const {
+        unordered_map<string, PathStamp> stamps;
+        pathStamps.ForEach([&](const std::string&, const std::pair<std::string, PathStamp>& stamp) {
+            stamps.insert(stamp);
+        });
+
+        return stamps;
+    }
+
+    void GameCache::InvalidatePath(const std::string& path) {
         std::lock_guard<std::mutex> guard(mutex);
 
-        auto it = conditionCache.find(boost::locale::to_lower(condition));
+        string key = CacheKey(path, true).Folded();
+        if (boost::ends_with(key, ".ghost"))
+            key = key.substr(0, key.length() - 6);
 
-        if (it != conditionCache.end())
-            return std::pair<bool, bool>(it->second, true);
+        BOOST_LOG_TRIVIAL(trace) << "Invalidating cached results that depend on: " << key;
+
+        InvalidatePathKey(key);
+
+        // Creating or deleting the path changes its parent's contents.
+        size_t pos = key.rfind('/');
+        if (pos == string::npos)
+            InvalidatePathKey("");
         else
-            return std::pair<bool, bool>(false, false);
+            InvalidatePathKey(key.substr(0, pos));
     }
 
-    bool GameCache::IsPluginActive(const std::string& plugin) const {
+    void GameCache::InvalidateActivePlugin(const std::string& plugin) {
         std::lock_guard<std::mutex> guard(mutex);
 
-        return activePlugins.find(boost::locale::to_lower(plugin)) != activePlugins.end();
+        InvalidateDependents(activeDependents, CacheKey(plugin, false).Folded());
     }
 
     void GameCache::ClearCache() {
         std::lock_guard<std::mutex> guard(mutex);
 
-        conditionCache.clear();
-        crcCache.clear();
-        activePlugins.clear();
+        conditionCache.Clear();
+        crcCache.Clear();
+        activePlugins.Clear();
+        fileCache.Clear();
+        regexCache.Clear();
+        versionCache.Clear();
+        directoryCache.Clear();
+        pathStamps.Clear();
+        pathDependents.clear();
+        activeDependents.clear();
+        regexDirectories.clear();
+    }
+
+    void GameCache::InvalidateDependents(std::unordered_map<std::string, std::unordered_set<std::string>>& dependents, const std::string& key) {
+        auto it = dependents.find(key);
+        if (it == dependents.end())
+            return;
+
+        for (const auto& condition : it->second) {
+            conditionCache.Erase(condition);
+        }
+        dependents.erase(it);
+    }
+
+    void GameCache::InvalidatePathKey(const std::string& key) {
+        crcCache.Erase(key);
+        fileCache.Erase(key);
+        versionCache.Erase(key);
+        directoryCache.Erase(key);
+        pathStamps.Erase(key);
+        InvalidateDependents(pathDependents, key);
+
+        auto it = regexDirectories.find(key);
+        if (it != regexDirectories.end()) {
+            for (const auto& regex : it->second) {
+                regexCache.Erase(regex);
+            }
+            regexDirectories.erase(it);
+        }
     }
 }
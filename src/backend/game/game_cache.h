@@ -25,13 +25,38 @@
 #ifndef __LOOT_GAME_CRC_CACHE__
 #define __LOOT_GAME_CRC_CACHE__
 
+#include "sharded_cache.h"
+
 #include <string>
 #include <cstdint>
+#include <ctime>
+#include <memory>
+#include <vector>
 #include <mutex>
 #include <unordered_map>
 #include <unordered_set>
 
 namespace loot {
+    // The Data folder paths and plugin active states that a cached condition
+    // result depends on. Paths may be files or directories.
+    struct CacheDependencies {
+        std::unordered_set<std::string> paths;
+        std::unordered_set<std::string> activePlugins;
+    };
+
+    // Used to detect changes to a path between cache refreshes. A missing
+    // path has a modification time of -1.
+    struct PathStamp {
+        PathStamp();
+        PathStamp(std::time_t modificationTime, uintmax_t size);
+
+        bool operator == (const PathStamp& rhs) const;
+        bool operator != (const PathStamp& rhs) const;
+
+        std::time_t modificationTime;
+        uintmax_t size;
+    };
+
     class GameCache {
     public:
         GameCache();
@@ -40,21 +65,71 @@ namespace loot {
         GameCache& operator=(const GameCache& cache);
 
         void CacheCrc(const std::string& plugin, uint32_t crc);
-        void CacheCondition(const std::string& condition, bool result);
+        void CacheCondition(const std::string& condition, bool result, const CacheDependencies& dependencies = CacheDependencies());
+        // Also invalidates conditions that depend on the active state of any
+        // plugin whose state has changed.
         void CacheActivePlugins(const std::unordered_set<std::string>& plugins);
 
+        // Caches for the results of individual condition functions, so that
+        // the same function call appearing in many different conditions is
+        // only evaluated once until the cache is next cleared.
+        void CacheFileExists(const std::string& file, bool exists);
+        void CacheRegexMatches(const std::string& regex, const std::string& directory, size_t count);
+        void CacheVersion(const std::string& file, const std::string& version);
+        void CacheDirectoryListing(const std::string& directory, const std::shared_ptr<const std::vector<std::string>>& filenames);
+
+        // Records the state of a path when results depending on it were
+        // cached. Does nothing if the path already has a stamp.
+        void CachePathStamp(const std::string& path, const PathStamp& stamp);
+
         // Returns 0 if no cached CRC.
         uint32_t GetCachedCrc(const std::string& plugin) const;
         // Returns false for second bool if no cached condition.
         std::pair<bool, bool> GetCachedCondition(const std::string& condition) const;
         bool IsPluginActive(const std::string& plugin) const;
 
+        // Return false for second bool if no cached value.
+        std::pair<bool, bool> GetCachedFileExists(const std::string& file) const;
+        std::pair<size_t, bool> GetCachedRegexMatches(const std::string& regex) const;
+        std::pair<std::string, bool> GetCachedVersion(const std::string& file) const;
+        std::pair<std::shared_ptr<const std::vector<std::string>>, bool> GetCachedDirectoryListing(const std::string& directory) const;
+        std::pair<PathStamp, bool> GetCachedPathStamp(const std::string& path) const;
+
+        // Gets the stamps of all paths that cached results depend on, keyed
+        // by the paths as they were first given.
+        std::unordered_map<std::string, PathStamp> GetCachedPathStamps() const;
+
+        // Discard cached results that depend on the given path or the
+        // directory containing it, or on the given plugin's active state.
+        void InvalidatePath(const std::string& path);
+        void InvalidateActivePlugin(const std::string& plugin);
+
         void ClearCache();
     private:
+        void InvalidateDependents(std::unordered_map<std::string, std::unordered_set<std::string>>& dependents, const std::string& key);
+        void InvalidatePathKey(const std::string& key);
+
         //Caches for condition results, CRCs and active plugins.
-        std::unordered_map<std::string, bool> conditionCache;
-        std::unordered_map<std::string, uint32_t> crcCache;
-        std::unordered_set<std::string> activePlugins;
+        ShardedCache<bool> conditionCache;
+        ShardedCache<uint32_t> crcCache;
+        ShardedCache<bool> activePlugins;
+
+        //Caches for condition function results.
+        ShardedCache<bool> fileCache;
+        //Regexes are keyed case-sensitively, as case changes the meaning
+        //of escapes such as \s and \S.
+        ShardedCache<size_t> regexCache;
+        ShardedCache<std::string> versionCache;
+        ShardedCache<std::shared_ptr<const std::vector<std::string>>> directoryCache;
+
+        //Path stamps, stored with the paths as they were first given.
+        ShardedCache<std::pair<std::string, PathStamp>> pathStamps;
+
+        //Maps from folded paths and plugin names to the cached conditions
+        //and regexes that depend on them. These are guarded by the mutex.
+        std::unordered_map<std::string, std::unordered_set<std::string>> pathDependents;
+        std::unordered_map<std::string, std::unordered_set<std::string>> activeDependents;
+        std::unordered_map<std::string, std::unordered_set<std::string>> regexDirectories;
 
         mutable std::mutex mutex;
     };
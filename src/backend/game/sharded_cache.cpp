@@ -0,0 +1,90 @@
+/*  LOOT
+
+    A load order optimisation tool for Oblivion, Skyrim, Fallout 3 and
+    Fallout: New Vegas.
+
+    Copyright (C) 2012-2015    WrinklyNinja
+
+    This file is part of LOOT.
+
+    LOOT is free software: you can redistribute
+    it and/or modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    LOOT is distributed in the hope that it will
+    be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with LOOT.  If not, see
+    <http://www.gnu.org/licenses/>.
+    */
+
+#include "sharded_cache.h"
+
+#include <cstdint>
+
+#include <boost/locale.hpp>
+
+using namespace std;
+
+namespace loot {
+    CacheKey::CacheKey(const std::string& key, bool isPath, bool isCaseSensitive)
+        : key(&key), length(key.length()), isPath(isPath), isCaseSensitive(isCaseSensitive), hash(0) {
+        for (const char c : key) {
+            if (!isCaseSensitive && static_cast<unsigned char>(c) > 0x7F) {
+                unicodeFolded = boost::locale::to_lower(key);
+                this->key = &unicodeFolded;
+                length = unicodeFolded.length();
+                break;
+            }
+        }
+
+        if (isPath) {
+            while (length > 0 && ((*this->key)[length - 1] == '/' || (*this->key)[length - 1] == '\\'))
+                --length;
+        }
+
+        // 64-bit FNV-1a.
+        uint64_t fnvHash = 14695981039346656037ULL;
+        for (size_t i = 0; i < length; ++i) {
+            fnvHash ^= static_cast<unsigned char>(FoldedChar(i));
+            fnvHash *= 1099511628211ULL;
+        }
+        hash = static_cast<size_t>(fnvHash);
+    }
+
+    size_t CacheKey::Hash() const {
+        return hash;
+    }
+
+    bool CacheKey::Equals(const std::string& foldedKey) const {
+        if (foldedKey.length() != length)
+            return false;
+
+        for (size_t i = 0; i < length; ++i) {
+            if (FoldedChar(i) != foldedKey[i])
+                return false;
+        }
+        return true;
+    }
+
+    std::string CacheKey::Folded() const {
+        string folded(length, '\0');
+        for (size_t i = 0; i < length; ++i) {
+            folded[i] = FoldedChar(i);
+        }
+        return folded;
+    }
+
+    char CacheKey::FoldedChar(size_t index) const {
+        char c = (*key)[index];
+        if (!isCaseSensitive && c >= 'A' && c <= 'Z')
+            return c - 'A' + 'a';
+        else if (isPath && c == '\\')
+            return '/';
+        return c;
+    }
+}
@@ -0,0 +1,181 @@
+/*  LOOT
+
+    A load order optimisation tool for Oblivion, Skyrim, Fallout 3 and
+    Fallout: New Vegas.
+
+    Copyright (C) 2012-2015    WrinklyNinja
+
+    This file is part of LOOT.
+
+    LOOT is free software: you can redistribute
+    it and/or modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    LOOT is distributed in the hope that it will
+    be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with LOOT.  If not, see
+    <http://www.gnu.org/licenses/>.
+    */
+#ifndef __LOOT_GAME_SHARDED_CACHE__
+#define __LOOT_GAME_SHARDED_CACHE__
+
+#include <array>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace loot {
+    // A case-insensitive cache key. ASCII keys are folded and hashed in place
+    // without allocating, and other keys are folded using Unicode rules.
+    // Path keys also have their separators normalised to '/', and trailing
+    // separators ignored. Case-sensitive keys are used as given, for keys
+    // such as regular expressions where case changes the meaning.
+    class CacheKey {
+    public:
+        CacheKey(const std::string& key, bool isPath, bool isCaseSensitive = false);
+        // The key may point to the object's own folded string.
+        CacheKey(const CacheKey&) = delete;
+        CacheKey& operator=(const CacheKey&) = delete;
+
+        size_t Hash() const;
+        // Checks if the key is equal to a key that has already been folded.
+        bool Equals(const std::string& foldedKey) const;
+        std::string Folded() const;
+    private:
+        char FoldedChar(size_t index) const;
+
+        const std::string * key;
+        std::string unicodeFolded;
+        size_t length;
+        bool isPath;
+        bool isCaseSensitive;
+        size_t hash;
+    };
+
+    // A map from case-insensitive keys to values that is split into shards,
+    // each guarded by its own mutex, so that threads looking up different
+    // keys rarely contend. Keys are folded once when inserted, unless the
+    // cache's keys are case-sensitive.
+    template<typename T>
+    class ShardedCache {
+    public:
+        explicit ShardedCache(bool pathKeys, bool caseSensitiveKeys = false)
+            : pathKeys(pathKeys), caseSensitiveKeys(caseSensitiveKeys) {}
+
+        ShardedCache(const ShardedCache& cache)
+            : pathKeys(cache.pathKeys), caseSensitiveKeys(cache.caseSensitiveKeys) {
+            for (size_t i = 0; i < shardCount; ++i) {
+                std::lock_guard<std::mutex> guard(cache.shards[i].mutex);
+                shards[i].buckets = cache.shards[i].buckets;
+            }
+        }
+
+        ShardedCache& operator=(const ShardedCache& cache) {
+            if (this == &cache)
+                return *this;
+
+            pathKeys = cache.pathKeys;
+            caseSensitiveKeys = cache.caseSensitiveKeys;
+            for (size_t i = 0; i < shardCount; ++i) {
+                std::lock(shards[i].mutex, cache.shards[i].mutex);
+                std::lock_guard<std::mutex> guard(shards[i].mutex, std::adopt_lock);
+                std::lock_guard<std::mutex> otherGuard(cache.shards[i].mutex, std::adopt_lock);
+                shards[i].buckets = cache.shards[i].buckets;
+            }
+
+            return *this;
+        }
+
+        // Does nothing if the key already has a value.
+        void Insert(const std::string& key, const T& value) {
+            CacheKey cacheKey(key, pathKeys, caseSensitiveKeys);
+            Shard& shard = shards[cacheKey.Hash() % shardCount];
+
+            std::lock_guard<std::mutex> guard(shard.mutex);
+            Bucket& bucket = shard.buckets[cacheKey.Hash()];
+            for (const auto& entry : bucket) {
+                if (cacheKey.Equals(entry.first))
+                    return;
+            }
+            bucket.push_back(std::pair<std::string, T>(cacheKey.Folded(), value));
+        }
+
+        // Returns false for second bool if the key has no value.
+        std::pair<T, bool> Find(const std::string& key) const {
+            CacheKey cacheKey(key, pathKeys, caseSensitiveKeys);
+            const Shard& shard = shards[cacheKey.Hash() % shardCount];
+
+            std::lock_guard<std::mutex> guard(shard.mutex);
+            auto it = shard.buckets.find(cacheKey.Hash());
+            if (it != shard.buckets.end()) {
+                for (const auto& entry : it->second) {
+                    if (cacheKey.Equals(entry.first))
+                        return std::pair<T, bool>(entry.second, true);
+                }
+            }
+            return std::pair<T, bool>(T(), false);
+        }
+
+        void Erase(const std::string& key) {
+            CacheKey cacheKey(key, pathKeys, caseSensitiveKeys);
+            Shard& shard = shards[cacheKey.Hash() % shardCount];
+
+            std::lock_guard<std::mutex> guard(shard.mutex);
+            auto it = shard.buckets.find(cacheKey.Hash());
+            if (it == shard.buckets.end())
+                return;
+
+            Bucket& bucket = it->second;
+            for (auto entryIt = bucket.begin(); entryIt != bucket.end(); ++entryIt) {
+                if (cacheKey.Equals(entryIt->first)) {
+                    bucket.erase(entryIt);
+                    break;
+                }
+            }
+            if (bucket.empty())
+                shard.buckets.erase(it);
+        }
+
+        void Clear() {
+            for (auto& shard : shards) {
+                std::lock_guard<std::mutex> guard(shard.mutex);
+                shard.buckets.clear();
+            }
+        }
+
+        // Calls function(foldedKey, value) for each entry, one shard at a time.
+        template<typename Function>
+        void ForEach(Function function) const {
+            for (const auto& shard : shards) {
+                std::lock_guard<std::mutex> guard(shard.mutex);
+                for (const auto& bucket : shard.buckets) {
+                    for (const auto& entry : bucket.second) {
+                        function(entry.first, entry.second);
+                    }
+                }
+            }
+        }
+    private:
+        typedef std::vector<std::pair<std::string, T>> Bucket;
+
+        struct Shard {
+            std::unordered_map<size_t, Bucket> buckets;
+            mutable std::mutex mutex;
+        };
+
+        static const size_t shardCount = 16;
+
+        bool pathKeys;
+        bool caseSensitiveKeys;
+        std::array<Shard, shardCount> shards;
+    };
+}
+
+#endif
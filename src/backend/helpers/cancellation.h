@@ -0,0 +1,58 @@
+/*  LOOT
+
+    A load order optimisation tool for Oblivion, Skyrim, Fallout 3 and
+    Fallout: New Vegas.
+
+    Copyright (C) 2013-2015    WrinklyNinja
+
+    This file is part of LOOT.
+
+    LOOT is free software: you can redistribute
+    it and/or modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    LOOT is distributed in the hope that it will
+    be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with LOOT.  If not, see
+    <http://www.gnu.org/licenses/>.
+*/
+#ifndef __LOOT_CANCELLATION__
+#define __LOOT_CANCELLATION__
+
+#include "../error.h"
+
+#include <atomic>
+#include <memory>
+
+namespace loot {
+    // A flag that long-running operations check as they go, so that another
+    // thread can stop them early. Copies of a token share the same flag.
+    class CancellationToken {
+    public:
+        CancellationToken() : cancelled(std::make_shared<std::atomic<bool>>(false)) {}
+
+        void Cancel() {
+            *cancelled = true;
+        }
+
+        bool IsCancelled() const {
+            return *cancelled;
+        }
+
+        // Throws an error with the cancelled code if cancellation has been
+        // requested.
+        void ThrowIfCancelled() const {
+            if (*cancelled)
+                throw error(error::cancelled, "The operation was cancelled.");
+        }
+    private:
+        std::shared_ptr<std::atomic<bool>> cancelled;
+    };
+}
+
+#endif
@@ -24,8 +24,15 @@
 
 #include "helpers.h"
 #include "version.h"
+#include "streams.h"
 
-#include <pseudosem.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+#include <boost/log/trivial.hpp>
 
 #ifdef _WIN32
 #   ifndef UNICODE
@@ -39,80 +46,385 @@
 
 namespace loot {
     using namespace std;
+    namespace fs = boost::filesystem;
 
-    Version::Version() {}
+    namespace {
+        // File versions are cached by path, and reused while the file's
+        // modification time and size are unchanged.
+        struct CachedFileVersion {
+            time_t modificationTime;
+            uintmax_t size;
+            string version;
+        };
 
-    Version::Version(const std::string& ver)
-        : verString(ver) {}
+        mutex fileVersionMutex;
+        unordered_map<string, CachedFileVersion> fileVersionCache;
 
-    Version::Version(const boost::filesystem::path& file) {
-#ifdef _WIN32
-        DWORD dummy = 0;
-        DWORD size = GetFileVersionInfoSize(ToWinWide(file.string()).c_str(), &dummy);
+#ifndef _WIN32
+        uint16_t ReadUInt16(const char * data) {
+            const unsigned char * bytes = reinterpret_cast<const unsigned char *>(data);
+            return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+        }
+
+        uint32_t ReadUInt32(const char * data) {
+            const unsigned char * bytes = reinterpret_cast<const unsigned char *>(data);
+            return static_cast<uint32_t>(bytes[0])
+                | (static_cast<uint32_t>(bytes[1]) << 8)
+                | (static_cast<uint32_t>(bytes[2]) << 16)
+                | (static_cast<uint32_t>(bytes[3]) << 24);
+        }
+
+        bool ReadAt(istream& in, uint64_t offset, char * buffer, size_t length) {
+            in.clear();
+            in.seekg(offset);
+            in.read(buffer, length);
+            return in.gcount() == static_cast<streamsize>(length);
+        }
+
+        struct Section {
+            uint32_t virtualAddress;
+            uint32_t virtualSize;
+            uint32_t rawDataOffset;
+        };
+
+        bool RvaToOffset(const vector<Section>& sections, uint32_t rva, uint64_t& offset) {
+            for (const auto& section : sections) {
+                if (rva >= section.virtualAddress && rva - section.virtualAddress < section.virtualSize) {
+                    offset = static_cast<uint64_t>(section.rawDataOffset) + (rva - section.virtualAddress);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Gets the offset of a resource directory entry's data, relative to
+        // the start of the resource section. If id is negative, the first
+        // entry is used, otherwise the first entry with that numeric ID.
+        bool FindResourceEntry(istream& in, uint64_t resourceOffset, uint32_t directory, int id, bool isDirectory, uint32_t& entryOffset) {
+            static const uint32_t subdirectoryFlag = 0x80000000;
+            char header[16];
+            if (!ReadAt(in, resourceOffset + directory, header, sizeof(header)))
+                return false;
+
+            uint32_t namedEntries = ReadUInt16(header + 12);
+            uint32_t idEntries = ReadUInt16(header + 14);
+
+            // Named entries come before ID entries.
+            uint32_t first = id < 0 ? 0 : namedEntries;
+            for (uint32_t i = first; i < namedEntries + idEntries; ++i) {
+                char entry[8];
+                if (!ReadAt(in, resourceOffset + directory + sizeof(header) + 8 * i, entry, sizeof(entry)))
+                    return false;
+
+                if (id >= 0 && ReadUInt32(entry) != static_cast<uint32_t>(id))
+                    continue;
+
+                uint32_t data = ReadUInt32(entry + 4);
+                if (((data & subdirectoryFlag) != 0) != isDirectory)
+                    return false;
 
-        if (size > 0) {
-            LPBYTE point = new BYTE[size];
-            UINT uLen;
-            VS_FIXEDFILEINFO *info;
+                entryOffset = data & ~subdirectoryFlag;
+                return true;
+            }
+            return false;
+        }
+
+        // Reads the file version from the VS_FIXEDFILEINFO structure in a PE
+        // file's RT_VERSION resource, formatted as Windows' version API
+        // reports it. Returns an empty string if the file has none.
+        string ReadFileVersion(const fs::path& file) {
+            static const uint16_t peOptionalHeader32 = 0x10b;
+            static const uint16_t peOptionalHeader64 = 0x20b;
+            static const uint32_t resourceDirectoryIndex = 2;
+            static const int versionResourceType = 16;
+            static const uint32_t fixedFileInfoSignature = 0xFEEF04BD;
+
+            loot::ifstream in(file, ios::binary);
+            if (!in)
+                return "";
+
+            char dosHeader[64];
+            if (!ReadAt(in, 0, dosHeader, sizeof(dosHeader)) || dosHeader[0] != 'M' || dosHeader[1] != 'Z')
+                return "";
+            uint32_t peOffset = ReadUInt32(dosHeader + 0x3C);
 
-            GetFileVersionInfo(ToWinWide(file.string()).c_str(), 0, size, point);
+            // PE signature followed by the COFF file header.
+            char fileHeader[24];
+            if (!ReadAt(in, peOffset, fileHeader, sizeof(fileHeader)) || string(fileHeader, 4) != string("PE\0\0", 4))
+                return "";
+            uint16_t sectionCount = ReadUInt16(fileHeader + 4 + 2);
+            uint16_t optionalHeaderSize = ReadUInt16(fileHeader + 4 + 16);
+
+            vector<char> optionalHeader(optionalHeaderSize);
+            if (optionalHeaderSize < 2 || !ReadAt(in, peOffset + sizeof(fileHeader), optionalHeader.data(), optionalHeader.size()))
+                return "";
+
+            size_t dataDirectories;
+            uint16_t magic = ReadUInt16(optionalHeader.data());
+            if (magic == peOptionalHeader32)
+                dataDirectories = 96;
+            else if (magic == peOptionalHeader64)
+                dataDirectories = 112;
+            else
+                return "";
+
+            size_t resourceDirectory = dataDirectories + 8 * resourceDirectoryIndex;
+            if (optionalHeader.size() < resourceDirectory + 8
+                || ReadUInt32(optionalHeader.data() + dataDirectories - 4) <= resourceDirectoryIndex)
+                return "";
+            uint32_t resourceRva = ReadUInt32(optionalHeader.data() + resourceDirectory);
+            if (resourceRva == 0)
+                return "";
+
+            vector<Section> sections;
+            uint64_t sectionTable = static_cast<uint64_t>(peOffset) + sizeof(fileHeader) + optionalHeaderSize;
+            for (uint16_t i = 0; i < sectionCount; ++i) {
+                char sectionHeader[40];
+                if (!ReadAt(in, sectionTable + sizeof(sectionHeader) * i, sectionHeader, sizeof(sectionHeader)))
+                    return "";
+                Section section;
+                section.virtualAddress = ReadUInt32(sectionHeader + 12);
+                section.virtualSize = max(ReadUInt32(sectionHeader + 8), ReadUInt32(sectionHeader + 16));
+                section.rawDataOffset = ReadUInt32(sectionHeader + 20);
+                sections.push_back(section);
+            }
 
-            VerQueryValue(point, L"\\", (LPVOID *)&info, &uLen);
+            uint64_t resourceOffset;
+            if (!RvaToOffset(sections, resourceRva, resourceOffset))
+                return "";
 
-            DWORD dwLeftMost = HIWORD(info->dwFileVersionMS);
-            DWORD dwSecondLeft = LOWORD(info->dwFileVersionMS);
-            DWORD dwSecondRight = HIWORD(info->dwFileVersionLS);
-            DWORD dwRightMost = LOWORD(info->dwFileVersionLS);
+            // The resource tree's levels are type, name and language.
+            uint32_t nameDirectory, languageDirectory, dataEntry;
+            if (!FindResourceEntry(in, resourceOffset, 0, versionResourceType, true, nameDirectory)
+                || !FindResourceEntry(in, resourceOffset, nameDirectory, -1, true, languageDirectory)
+                || !FindResourceEntry(in, resourceOffset, languageDirectory, -1, false, dataEntry))
+                return "";
 
-            delete[] point;
+            char dataHeader[16];
+            if (!ReadAt(in, resourceOffset + dataEntry, dataHeader, sizeof(dataHeader)))
+                return "";
 
-            verString = to_string(dwLeftMost) + '.' + to_string(dwSecondLeft) + '.' + to_string(dwSecondRight) + '.' + to_string(dwRightMost);
+            uint64_t versionOffset;
+            if (!RvaToOffset(sections, ReadUInt32(dataHeader), versionOffset))
+                return "";
+
+            // VS_VERSIONINFO starts with a header and its UTF-16 key, which
+            // is followed by the 32-bit aligned VS_FIXEDFILEINFO.
+            char versionInfo[128];
+            size_t versionSize = min<size_t>(ReadUInt32(dataHeader + 4), sizeof(versionInfo));
+            if (!ReadAt(in, versionOffset, versionInfo, versionSize))
+                return "";
+
+            for (size_t i = 0; i + 16 <= versionSize; i += 4) {
+                if (ReadUInt32(versionInfo + i) != fixedFileInfoSignature)
+                    continue;
+
+                uint32_t versionMS = ReadUInt32(versionInfo + i + 8);
+                uint32_t versionLS = ReadUInt32(versionInfo + i + 12);
+
+                return to_string(versionMS >> 16) + '.' + to_string(versionMS & 0xFFFF) + '.' + to_string(versionLS >> 16) + '.' + to_string(versionLS & 0xFFFF);
+            }
+            return "";
         }
 #else
-        // ensure filename has no quote characters in it to avoid command injection attacks
-        if (string::npos != file.string().find('"')) {
-            // command mostly borrowed from the gnome-exe-thumbnailer.sh script
-            // wrestool is part of the icoutils package
-            string cmd = "wrestool --extract --raw --type=version \"" + file.string() + "\" | tr '\\0, ' '\\t.\\0' | sed 's/\\t\\t/_/g' | tr -c -d '[:print:]' | sed -r 's/.*Version[^0-9]*([0-9]+(\\.[0-9]+)+).*/\\1/'";
-
-            FILE *fp = popen(cmd.c_str(), "r");
-
-            // read out the version string
-            static const uint32_t BUFSIZE = 32;
-            char buf[BUFSIZE];
-            if (nullptr != fgets(buf, BUFSIZE, fp)) {
-                verString = string(buf);
+        string ReadFileVersion(const fs::path& file) {
+            string version;
+            DWORD dummy = 0;
+            DWORD size = GetFileVersionInfoSize(ToWinWide(file.string()).c_str(), &dummy);
+
+            if (size > 0) {
+                LPBYTE point = new BYTE[size];
+                UINT uLen;
+                VS_FIXEDFILEINFO *info;
+
+                GetFileVersionInfo(ToWinWide(file.string()).c_str(), 0, size, point);
+
+                VerQueryValue(point, L"\\", (LPVOID *)&info, &uLen);
+
+                DWORD dwLeftMost = HIWORD(info->dwFileVersionMS);
+                DWORD dwSecondLeft = LOWORD(info->dwFileVersionMS);
+                DWORD dwSecondRight = HIWORD(info->dwFileVersionLS);
+                DWORD dwRightMost = LOWORD(info->dwFileVersionLS);
+
+                delete[] point;
+
+                version = to_string(dwLeftMost) + '.' + to_string(dwSecondLeft) + '.' + to_string(dwSecondRight) + '.' + to_string(dwRightMost);
             }
-            pclose(fp);
+            return version;
         }
 #endif
     }
 
+    Version::Version() {}
+
+    Version::Version(const std::string& ver)
+        : verString(ver) {
+        Decompose();
+    }
+
+    Version::Version(const boost::filesystem::path& file) {
+        boost::system::error_code ec;
+        time_t modificationTime = fs::last_write_time(file, ec);
+        uintmax_t size = ec ? 0 : fs::file_size(file, ec);
+        if (ec)
+            return;
+
+        string key = file.string();
+        {
+            lock_guard<mutex> guard(fileVersionMutex);
+            auto it = fileVersionCache.find(key);
+            if (it != fileVersionCache.end()
+                && it->second.modificationTime == modificationTime
+                && it->second.size == size) {
+                verString = it->second.version;
+                Decompose();
+                return;
+            }
+        }
+
+        verString = ReadFileVersion(file);
+        Decompose();
+        BOOST_LOG_TRIVIAL(trace) << "Read version \"" << verString << "\" from file: " << key;
+
+        CachedFileVersion cached;
+        cached.modificationTime = modificationTime;
+        cached.size = size;
+        cached.version = verString;
+
+        lock_guard<mutex> guard(fileVersionMutex);
+        fileVersionCache[key] = cached;
+    }
+
     string Version::AsString() const {
         return verString;
     }
 
+    // Versions are compared using the same rules as Pseudosem. Anything
+    // after a '+' is build metadata and is ignored. The release and
+    // pre-release parts are split at the first '-'. Each part is made of
+    // identifiers separated by periods, spaces, colons or underscores.
+    // Numeric identifiers compare numerically and sort before other
+    // identifiers, which compare case-insensitively. Missing release
+    // identifiers count as zero, and a pre-release sorts before its release.
+    void Version::Decompose() {
+        release.clear();
+        preRelease.clear();
+
+        size_t first = verString.find_first_not_of(" \t\r\n");
+        if (first == string::npos)
+            return;
+        size_t last = min(verString.find('+', first), verString.find_last_not_of(" \t\r\n") + 1);
+
+        if ((verString[first] == 'v' || verString[first] == 'V')
+            && first + 1 < last && isdigit(static_cast<unsigned char>(verString[first + 1])))
+            ++first;
+
+        vector<Identifier> * identifiers = &release;
+        string token;
+        auto addToken = [&]() {
+            if (token.empty())
+                return;
+
+            Identifier identifier;
+            identifier.isNumeric = all_of(begin(token), end(token), [](char c) {
+                return isdigit(static_cast<unsigned char>(c)) != 0;
+            });
+            identifier.number = 0;
+            if (identifier.isNumeric) {
+                size_t firstDigit = token.find_first_not_of('0');
+                token.erase(0, firstDigit == string::npos ? token.length() : firstDigit);
+                // Numbers too large for 64 bits compare as text.
+                if (token.length() > 19)
+                    identifier.isNumeric = false;
+                else if (!token.empty())
+                    identifier.number = stoull(token);
+            }
+            else
+                transform(begin(token), end(token), begin(token), [](char c) {
+                    return static_cast<char>(tolower(static_cast<unsigned char>(c)));
+                });
+            identifier.text = token;
+            identifiers->push_back(identifier);
+            token.clear();
+        };
+
+        for (size_t i = first; i < last; ++i) {
+            char c = verString[i];
+            if (c == '-' && identifiers == &release) {
+                addToken();
+                identifiers = &preRelease;
+            }
+            else if (c == '.' || c == ' ' || c == ':' || c == '_')
+                addToken();
+            else
+                token += c;
+        }
+        addToken();
+    }
+
+    int Version::Identifier::Compare(const Identifier& other) const {
+        if (isNumeric && other.isNumeric) {
+            if (number == other.number)
+                return 0;
+            return number < other.number ? -1 : 1;
+        }
+        else if (isNumeric)
+            return -1;
+        else if (other.isNumeric)
+            return 1;
+
+        int result = text.compare(other.text);
+        return result < 0 ? -1 : (result > 0 ? 1 : 0);
+    }
+
+    int Version::Compare(const Version& ver) const {
+        Identifier zero;
+        zero.isNumeric = true;
+        zero.number = 0;
+
+        for (size_t i = 0; i < max(release.size(), ver.release.size()); ++i) {
+            const Identifier& lhs = i < release.size() ? release[i] : zero;
+            const Identifier& rhs = i < ver.release.size() ? ver.release[i] : zero;
+            int result = lhs.Compare(rhs);
+            if (result != 0)
+                return result;
+        }
+
+        if (preRelease.empty() || ver.preRelease.empty())
+            return preRelease.empty() ? (ver.preRelease.empty() ? 0 : 1) : -1;
+
+        for (size_t i = 0; i < min(preRelease.size(), ver.preRelease.size()); ++i) {
+            int result = preRelease[i].Compare(ver.preRelease[i]);
+            if (result != 0)
+                return result;
+        }
+
+        if (preRelease.size() == ver.preRelease.size())
+            return 0;
+        return preRelease.size() < ver.preRelease.size() ? -1 : 1;
+    }
+
     bool Version::operator < (const Version& ver) const {
-        return pseudosem::compare(this->verString, ver.AsString()) < 0;
+        return Compare(ver) < 0;
     }
 
     bool Version::operator > (const Version& ver) const {
-        return pseudosem::compare(this->verString, ver.AsString()) > 0;
+        return Compare(ver) > 0;
     }
 
     bool Version::operator >= (const Version& ver) const {
-        return pseudosem::compare(this->verString, ver.AsString()) >= 0;
+        return Compare(ver) >= 0;
     }
 
     bool Version::operator <= (const Version& ver) const {
-        return pseudosem::compare(this->verString, ver.AsString()) <= 0;
+        return Compare(ver) <= 0;
     }
 
     bool Version::operator == (const Version& ver) const {
-        return pseudosem::compare(this->verString, ver.AsString()) == 0;
+        return Compare(ver) == 0;
     }
 
     bool Version::operator != (const Version& ver) const {
-        return pseudosem::compare(this->verString, ver.AsString()) != 0;
+        return Compare(ver) != 0;
     }
         }
@@ -26,21 +26,34 @@
 #define __LOOT_VERSION__
 
 #include <string>
+#include <vector>
 #include <boost/filesystem.hpp>
 
 namespace loot {
     //Version class for more robust version comparisons.
     class Version {
     private:
+        // Version strings are split into identifiers once, on construction.
+        struct Identifier {
+            bool isNumeric;
+            unsigned long long number;
+            std::string text;
+
+            int Compare(const Identifier& other) const;
+        };
+
         std::string verString;
+        std::vector<Identifier> release;
+        std::vector<Identifier> preRelease;
+
+        void Decompose();
+        int Compare(const Version& ver) const;
     public:
         Version();
         Version(const std::string& ver);
         Version(const boost::filesystem::path& file);
 
         std::string AsString() const;
-        void Decompose(std::vector<unsigned long>& release,
-                       std::vector<std::string>& preRelease) const;
 
         bool operator > (const Version&) const;
         bool operator < (const Version&) const;
@@ -28,6 +28,8 @@
 #include <set>
 #include <unordered_set>
 
+#include <boost/container/flat_set.hpp>
+
 #include <yaml-cpp/yaml.h>
 
 namespace YAML {
@@ -65,6 +67,41 @@ namespace YAML {
         return out;
     }
 
+    template<class T, class Compare>
+    struct convert < boost::container::flat_set<T, Compare> > {
+        static Node encode(const boost::container::flat_set<T, Compare>& rhs) {
+            Node node;
+            for (const auto &element : rhs) {
+                node.push_back(element);
+            }
+            return node;
+        }
+
+        static bool decode(const Node& node, boost::container::flat_set<T, Compare>& rhs) {
+            if (!node.IsSequence())
+                throw RepresentationException(node.Mark(), "bad conversion: set must be a sequence of elements");
+
+            rhs.clear();
+            rhs.reserve(node.size());
+            for (const auto &element : node) {
+                if (!rhs.insert(element.template as<T>()).second)
+                    throw RepresentationException(node.Mark(), "bad conversion: set elements must be unique");
+            }
+            return true;
+        }
+    };
+
+    template<class T, class Compare>
+    Emitter& operator << (Emitter& out, const boost::container::flat_set<T, Compare>& rhs) {
+        out << BeginSeq;
+        for (const auto &element : rhs) {
+            out << element;
+        }
+        out << EndSeq;
+
+        return out;
+    }
+
     template<class T, class Hash>
     struct convert < std::unordered_set<T, Hash> > {
         static Node encode(const std::unordered_set<T, Hash>& rhs) {
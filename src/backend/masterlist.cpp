@@ -26,6 +26,13 @@
 #include "helpers/git_helper.h"
 #include "game/game.h"
 #include "error.h"
+#include "helpers/helpers.h"
+#include "helpers/streams.h"
+
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
 
 #include <boost/log/trivial.hpp>
 
@@ -35,6 +42,401 @@ namespace fs = boost::filesystem;
 namespace lc = boost::locale;
 
 namespace loot {
+    namespace {
+        // Masterlists shared by LoadShared(), keyed by their canonical path,
+        // CRC and size.
+        mutex sharedMasterlistsMutex;
+        unordered_map<string, weak_ptr<const Masterlist>> sharedMasterlists;
+
+        // Binary masterlist caches start with this signature and format
+        // version, followed by a key identifying the masterlist file and
+        // content they were written from, a table of the distinct strings
+        // used, and then the global messages and plugin entries. Strings
+        // are written as indices into the table.
+        const char cacheSignature[8] = { 'L', 'O', 'O', 'T', 'M', 'L', 'C', '\0' };
+        const uint32_t cacheFormatVersion = 2;
+
+        // Gets the key for a masterlist file's current content from its
+        // absolute path, modification time and size, so that checking a
+        // cache doesn't need the file to be read.
+        string GetCacheSourceKey(const fs::path& path) {
+            return fs::absolute(path).string()
+                + "|" + to_string(static_cast<int64_t>(fs::last_write_time(path)))
+                + "|" + to_string(fs::file_size(path));
+        }
+
+        class CacheWriter {
+        public:
+            void Write(uint32_t value) {
+                for (int i = 0; i < 4; ++i)
+                    body += static_cast<char>((value >> (8 * i)) & 0xFF);
+            }
+
+            void Write(bool value) {
+                body += value ? '\1' : '\0';
+            }
+
+            void Write(const std::string& value) {
+                auto it = stringIndices.find(value);
+                if (it == stringIndices.end()) {
+                    it = stringIndices.insert(make_pair(value, static_cast<uint32_t>(strings.size()))).first;
+                    strings.push_back(&it->first);
+                }
+                Write(it->second);
+            }
+
+            void Write(const Message& message) {
+                Write(static_cast<uint32_t>(message.Type()));
+                Write(message.Condition());
+                vector<MessageContent> content(message.Content());
+                Write(static_cast<uint32_t>(content.size()));
+                for (const auto& item : content) {
+                    Write(item.Str());
+                    Write(static_cast<uint32_t>(item.Language()));
+                }
+            }
+
+            void Write(const boost::container::flat_set<File>& files) {
+                Write(static_cast<uint32_t>(files.size()));
+                for (const auto& file : files) {
+                    Write(file.Name());
+                    Write(file.DisplayName());
+                    Write(file.Condition());
+                }
+            }
+
+            void Write(const PluginMetadata& plugin) {
+                Write(plugin.Name());
+                Write(plugin.Enabled());
+                Write(plugin.IsPriorityExplicit());
+                Write(static_cast<uint32_t>(plugin.Priority()));
+                Write(plugin.LoadAfter());
+                Write(plugin.Reqs());
+                Write(plugin.Incs());
+
+                Write(static_cast<uint32_t>(plugin.Messages().size()));
+                for (const auto& message : plugin.Messages())
+                    Write(message);
+
+                Write(static_cast<uint32_t>(plugin.Tags().size()));
+                for (const auto& tag : plugin.Tags()) {
+                    Write(tag.Name());
+                    Write(tag.IsAddition());
+                    Write(tag.Condition());
+                }
+
+                Write(static_cast<uint32_t>(plugin.DirtyInfo().size()));
+                for (const auto& info : plugin.DirtyInfo()) {
+                    Write(info.CRC());
+                    Write(static_cast<uint32_t>(info.ITMs()));
+                    Write(static_cast<uint32_t>(info.DeletedRefs()));
+                    Write(static_cast<uint32_t>(info.DeletedNavmeshes()));
+                    Write(info.CleaningUtility());
+                }
+
+                Write(static_cast<uint32_t>(plugin.Locations().size()));
+                for (const auto& location : plugin.Locations()) {
+                    Write(location.URL());
+                    Write(location.Name());
+                }
+            }
+
+            // Writes the header, string table and body to the given stream.
+            void Save(std::ostream& out, const std::string& sourceKey) {
+                string body;
+                body.swap(this->body);
+
+                out.write(cacheSignature, sizeof(cacheSignature));
+                Write(cacheFormatVersion);
+                Write(static_cast<uint32_t>(sourceKey.length()));
+                this->body += sourceKey;
+                Write(static_cast<uint32_t>(strings.size()));
+                for (const auto& str : strings) {
+                    Write(static_cast<uint32_t>(str->length()));
+                    this->body += *str;
+                }
+                out.write(this->body.data(), this->body.size());
+                out.write(body.data(), body.size());
+            }
+        private:
+            string body;
+            unordered_map<string, uint32_t> stringIndices;
+            vector<const string*> strings;
+        };
+
+        class CacheReader {
+        public:
+            CacheReader(const std::string& data) : data(data), pos(0) {}
+
+            // Returns false if the header doesn't match the given masterlist
+            // file details, otherwise reads the string table.
+            bool ReadHeader(const std::string& sourceKey) {
+                if (data.compare(0, sizeof(cacheSignature), cacheSignature, sizeof(cacheSignature)) != 0)
+                    return false;
+                pos = sizeof(cacheSignature);
+
+                if (ReadUInt32() != cacheFormatVersion || ReadUInt32() != sourceKey.length())
+                    return false;
+                Require(sourceKey.length());
+                if (data.compare(pos, sourceKey.length(), sourceKey) != 0)
+                    return false;
+                pos += sourceKey.length();
+
+                uint32_t count = ReadUInt32();
+                strings.reserve(count);
+                for (uint32_t i = 0; i < count; ++i) {
+                    uint32_t length = ReadUInt32();
+                    Require(length);
+                    strings.push_back(data.substr(pos, length));
+                    pos += length;
+                }
+                return true;
+            }
+
+            bool AtEnd() const {
+                return pos == data.length();
+            }
+
+            uint32_t ReadUInt32() {
+                Require(4);
+                uint32_t value = 0;
+                for (int i = 0; i < 4; ++i)
+                    value |= static_cast<uint32_t>(static_cast<unsigned char>(data[pos + i])) << (8 * i);
+                pos += 4;
+                return value;
+            }
+
+            bool ReadBool() {
+                Require(1);
+                return data[pos++] != '\0';
+            }
+
+            const std::string& ReadString() {
+                uint32_t index = ReadUInt32();
+                if (index >= strings.size())
+                    throw runtime_error("invalid string index");
+                return strings[index];
+            }
+
+            Message ReadMessage() {
+                unsigned int type = ReadUInt32();
+                string condition(ReadString());
+                vector<MessageContent> content(ReadUInt32());
+                for (auto& item : content) {
+                    string str(ReadString());
+                    item = MessageContent(str, ReadUInt32());
+                }
+                return Message(type, content, condition);
+            }
+
+            boost::container::flat_set<File> ReadFiles() {
+                boost::container::flat_set<File> files;
+                uint32_t count = ReadUInt32();
+                files.reserve(count);
+                for (uint32_t i = 0; i < count; ++i) {
+                    string name(ReadString());
+                    string display(ReadString());
+                    files.insert(files.end(), File(name, display, ReadString()));
+                }
+                return files;
+            }
+
+            PluginMetadata ReadPlugin() {
+                PluginMetadata plugin(ReadString());
+                plugin.Enabled(ReadBool());
+                plugin.SetPriorityExplicit(ReadBool());
+                plugin.Priority(static_cast<int>(ReadUInt32()));
+                plugin.LoadAfter(ReadFiles());
+                plugin.Reqs(ReadFiles());
+                plugin.Incs(ReadFiles());
+
+                vector<Message> messages;
+                uint32_t count = ReadUInt32();
+                messages.reserve(count);
+                for (uint32_t i = 0; i < count; ++i)
+                    messages.push_back(ReadMessage());
+                plugin.Messages(std::move(messages));
+
+                boost::container::flat_set<Tag> tags;
+                count = ReadUInt32();
+                tags.reserve(count);
+                for (uint32_t i = 0; i < count; ++i) {
+                    string name(ReadString());
+                    bool isAddition = ReadBool();
+                    tags.insert(tags.end(), Tag(name, isAddition, ReadString()));
+                }
+                plugin.Tags(std::move(tags));
+
+                boost::container::flat_set<PluginDirtyInfo> dirtyInfo;
+                count = ReadUInt32();
+                dirtyInfo.reserve(count);
+                for (uint32_t i = 0; i < count; ++i) {
+                    uint32_t crc = ReadUInt32();
+                    unsigned int itm = ReadUInt32();
+                    unsigned int ref = ReadUInt32();
+                    unsigned int nav = ReadUInt32();
+                    dirtyInfo.insert(dirtyInfo.end(), PluginDirtyInfo(crc, itm, ref, nav, ReadString()));
+                }
+                plugin.DirtyInfo(std::move(dirtyInfo));
+
+                boost::container::flat_set<Location> locations;
+                count = ReadUInt32();
+                locations.reserve(count);
+                for (uint32_t i = 0; i < count; ++i) {
+                    string url(ReadString());
+                    locations.insert(locations.end(), Location(url, ReadString()));
+                }
+                plugin.Locations(std::move(locations));
+
+                return plugin;
+            }
+        private:
+            void Require(size_t length) const {
+                if (data.length() - pos < length)
+                    throw runtime_error("unexpected end of data");
+            }
+
+            const std::string& data;
+            size_t pos;
+            vector<string> strings;
+        };
+    }
+
+    void Masterlist::Load(const boost::filesystem::path& path, const boost::filesystem::path& cacheDir) {
+        if (cacheDir.empty()) {
+            MetadataList::Load(path);
+            return;
+        }
+
+        // Get the key before parsing, so that a cache written from a file
+        // that changed during the parse doesn't match the changed file.
+        const string sourceKey = GetCacheSourceKey(path);
+        const fs::path cachePath = CachePath(path, cacheDir);
+
+        try {
+            if (fs::exists(cachePath) && LoadCache(cachePath, sourceKey))
+                return;
+        }
+        catch (std::exception& e) {
+            BOOST_LOG_TRIVIAL(warning) << "Unable to read masterlist cache at " << cachePath << ": " << e.what();
+            clear();
+        }
+
+        MetadataList::Load(path);
+
+        // The cache only saves time, so failing to write it doesn't fail
+        // the load.
+        try {
+            SaveCache(cachePath, sourceKey);
+        }
+        catch (std::exception& e) {
+            BOOST_LOG_TRIVIAL(warning) << "Unable to write masterlist cache to " << cachePath << ": " << e.what();
+        }
+    }
+
+    std::shared_ptr<const Masterlist> Masterlist::LoadShared(const boost::filesystem::path& path) {
+        uint32_t crc = GetCrc32(path);
+        uintmax_t size = fs::file_size(path);
+        string key = fs::canonical(path).string() + "|" + to_string(crc) + "|" + to_string(size);
+
+        {
+            lock_guard<mutex> guard(sharedMasterlistsMutex);
+            auto it = sharedMasterlists.find(key);
+            if (it != sharedMasterlists.end()) {
+                shared_ptr<const Masterlist> masterlist = it->second.lock();
+                if (masterlist) {
+                    BOOST_LOG_TRIVIAL(debug) << "Using the already loaded masterlist at " << path;
+                    return masterlist;
+                }
+            }
+        }
+
+        // Load without holding the lock so that different masterlists can
+        // be loaded at the same time.
+        shared_ptr<Masterlist> loaded = make_shared<Masterlist>();
+        loaded->Load(path);
+
+        lock_guard<mutex> guard(sharedMasterlistsMutex);
+        for (auto it = sharedMasterlists.begin(); it != sharedMasterlists.end();) {
+            if (it->second.expired())
+                it = sharedMasterlists.erase(it);
+            else
+                ++it;
+        }
+
+        // Another caller may have loaded the same file in the meantime.
+        auto it = sharedMasterlists.find(key);
+        if (it != sharedMasterlists.end())
+            return it->second.lock();
+
+        sharedMasterlists.insert(make_pair(key, weak_ptr<const Masterlist>(loaded)));
+        return loaded;
+    }
+
+    boost::filesystem::path Masterlist::CachePath(const boost::filesystem::path& path, const boost::filesystem::path& cacheDir) {
+        return cacheDir / (path.stem().string() + ".bin");
+    }
+
+    bool Masterlist::LoadCache(const boost::filesystem::path& cachePath, const std::string& sourceKey) {
+        BOOST_LOG_TRIVIAL(debug) << "Loading masterlist cache: " << cachePath;
+
+        string data;
+        loot::ifstream in(cachePath, ios::binary);
+        data.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        in.close();
+
+        CacheReader reader(data);
+        if (!reader.ReadHeader(sourceKey)) {
+            BOOST_LOG_TRIVIAL(debug) << "The masterlist cache is out of date.";
+            return false;
+        }
+
+        clear();
+        uint32_t count = reader.ReadUInt32();
+        for (uint32_t i = 0; i < count; ++i)
+            messages.push_back(reader.ReadMessage());
+
+        count = reader.ReadUInt32();
+        for (uint32_t i = 0; i < count; ++i) {
+            PluginMetadata plugin(reader.ReadPlugin());
+            if (plugin.IsRegexPlugin())
+                AddRegexPlugin(plugin);
+            else
+                InsertPlugin(plugin);
+        }
+
+        if (!reader.AtEnd())
+            throw runtime_error("unexpected data after the last entry");
+
+        BuildCombinedRegex();
+
+        BOOST_LOG_TRIVIAL(debug) << "Masterlist cache loaded successfully.";
+        return true;
+    }
+
+    void Masterlist::SaveCache(const boost::filesystem::path& cachePath, const std::string& sourceKey) const {
+        BOOST_LOG_TRIVIAL(trace) << "Saving masterlist cache to: " << cachePath;
+
+        CacheWriter writer;
+        writer.Write(static_cast<uint32_t>(messages.size()));
+        for (const auto& message : messages)
+            writer.Write(message);
+
+        writer.Write(static_cast<uint32_t>(plugins.size() + regexPlugins.size()));
+        for (const auto& plugin : plugins)
+            writer.Write(*plugin.second);
+        for (const auto& plugin : regexPlugins)
+            writer.Write(*plugin);
+
+        // Write to a temporary file first so that an interrupted write
+        // can't leave a truncated cache behind.
+        fs::path tempPath = cachePath.string() + ".tmp";
+        loot::ofstream out(tempPath, ios::binary);
+        writer.Save(out, sourceKey);
+        out.close();
+        fs::rename(tempPath, cachePath);
+    }
+
     Masterlist::Info Masterlist::GetInfo(const boost::filesystem::path& path, bool shortID) {
         // Compare HEAD and working copy, and get revision info.
         GitHelper git;
@@ -27,6 +27,8 @@
 
 #include "metadata_list.h"
 
+#include <cstdint>
+#include <memory>
 #include <string>
 
 #include <boost/filesystem.hpp>
@@ -41,12 +43,33 @@ namespace loot {
             std::string date;
         };
 
+        // Loads the masterlist. If a cache folder is given, a binary cache of
+        // the decoded masterlist is kept in it and used instead of parsing
+        // the YAML while the file's size and modification time are
+        // unchanged. The folder should be one that LOOT owns.
+        void Load(const boost::filesystem::path& path,
+                  const boost::filesystem::path& cacheDir = boost::filesystem::path());
+
+        // Returns the loaded masterlist at the given path, sharing it with
+        // any other callers that loaded the same file with the same
+        // content. The list is released when the last caller releases it.
+        // No binary cache is used, so no files are written.
+        static std::shared_ptr<const Masterlist> LoadShared(const boost::filesystem::path& path);
+
         bool Update(const Game& game);
         bool Update(const boost::filesystem::path& path,
                     const std::string& repoURL,
                     const std::string& repoBranch);
 
         static Info GetInfo(const boost::filesystem::path& path, bool shortID);
+
+        // Gets the path of the binary cache for a masterlist in the given
+        // cache folder.
+        static boost::filesystem::path CachePath(const boost::filesystem::path& path,
+                                                 const boost::filesystem::path& cacheDir);
+    private:
+        bool LoadCache(const boost::filesystem::path& cachePath, const std::string& sourceKey);
+        void SaveCache(const boost::filesystem::path& cachePath, const std::string& sourceKey) const;
     };
 }
 
@@ -40,7 +40,11 @@
 #include "../error.h"
 
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <regex>
+#include <set>
+#include <unordered_map>
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/regex.hpp>
@@ -65,7 +69,13 @@ namespace loot {
     class ConditionGrammar : public qi::grammar < Iterator, bool(), Skipper > {
     public:
         ConditionGrammar() : ConditionGrammar(nullptr) {}
-        ConditionGrammar(Game * game) : ConditionGrammar::base_type(expression, "condition grammar"), _game(game) {
+        ConditionGrammar(Game * game) : ConditionGrammar(game, nullptr, nullptr) {}
+        // If probes is not null, the grammar doesn't evaluate any functions,
+        // and instead records the filesystem-dependent function calls made
+        // by the condition in a canonical form that can itself be evaluated.
+        // If dependencies is not null, the paths and plugin active states
+        // that evaluated functions depend on are recorded in it.
+        ConditionGrammar(Game * game, std::set<std::string> * probes, CacheDependencies * dependencies) : ConditionGrammar::base_type(expression, "condition grammar"), _game(game), _probes(probes), _dependencies(dependencies) {
             expression =
                 qi::eps >
                 compound[qi::labels::_val = qi::labels::_1]
@@ -139,7 +149,22 @@ namespace loot {
         qi::rule<Iterator, std::string()> quotedStr, filePath, comparator;
         qi::rule<Iterator, char()> invalidPathChars;
 
+        static const std::regex separatorRegex;
+        static std::unordered_map<std::string, std::shared_ptr<const std::pair<boost::filesystem::path, std::regex>>> splitRegexCache;
+        static std::mutex splitRegexMutex;
+
         Game * _game;
+        std::set<std::string> * _probes;
+        CacheDependencies * _dependencies;
+
+        // Records that the result depends on the given path, and makes sure
+        // that changes to the path can be detected.
+        void AddPathDependency(const std::string& path) const {
+            if (_dependencies != nullptr)
+                _dependencies->paths.insert(path);
+
+            _game->TrackPath(path);
+        }
 
         //Eval's exact paths. Check for files and ghosted plugins.
         void CheckFile(bool& result, const std::string& file) const {
@@ -155,13 +180,25 @@ namespace loot {
                 throw loot::error(loot::error::invalid_args, boost::locale::translate("Invalid file path:").str() + " " + file);
             }
 
+            if (_probes != nullptr) {
+                _probes->insert("file(\"" + file + "\")");
+                return;
+            }
+
             if (_game == nullptr)
                 return;
 
-            if (boost::iends_with(file, ".esp") || boost::iends_with(file, ".esm"))
-                result = boost::filesystem::exists(_game->DataPath() / file) || boost::filesystem::exists(_game->DataPath() / (file + ".ghost"));
-            else
-                result = boost::filesystem::exists(_game->DataPath() / file);
+            AddPathDependency(file);
+
+            auto cachedValue = _game->GetCachedFileExists(file);
+            if (cachedValue.second) {
+                result = cachedValue.first;
+                return;
+            }
+
+            result = _game->DataFileExists(file);
+
+            _game->CacheFileExists(file, result);
 
             if (result)
                 BOOST_LOG_TRIVIAL(trace) << "The file does exist.";
@@ -170,7 +207,7 @@ namespace loot {
         }
 
         // Split a regex string into the non-regex filesystem parent path, and the regex filename.
-        std::pair<boost::filesystem::path, std::regex> SplitRegex(const std::string& regex) const {
+        std::shared_ptr<const std::pair<boost::filesystem::path, std::regex>> SplitRegex(const std::string& regex) const {
             //Can't support a regex string where all path components may be regex, since this could
             //lead to massive scanning if an unfortunately-named directory is encountered.
             //As such, only the filename portion can be a regex. Need to separate that from the rest
@@ -181,6 +218,15 @@ namespace loot {
             In C++ string literals, the backslash must be escaped once more to give "\\\\".
             Split the regex with another regex! */
 
+            // Regexes are compiled once per process, as the same regex is
+            // likely to be used by more than one condition.
+            {
+                std::lock_guard<std::mutex> guard(splitRegexMutex);
+                auto it = splitRegexCache.find(regex);
+                if (it != splitRegexCache.end())
+                    return it->second;
+            }
+
             try {
                 std::regex(regex, std::regex::ECMAScript | std::regex::icase);
             }
@@ -188,9 +234,7 @@ namespace loot {
                 throw loot::error(loot::error::invalid_args, (boost::format(boost::locale::translate("Invalid regex string \"%1%\": %2%")) % regex % e.what()).str());
             }
 
-            std::regex sepReg("/|(\\\\\\\\)", std::regex::ECMAScript);
-
-            std::sregex_token_iterator it(regex.begin(), regex.end(), sepReg, -1);
+            std::sregex_token_iterator it(regex.begin(), regex.end(), separatorRegex, -1);
             std::vector<std::string> components(it, std::sregex_token_iterator());
 
             std::string filename = components.back();
@@ -215,65 +259,95 @@ namespace loot {
                 throw loot::error(loot::error::invalid_args, (boost::format(boost::locale::translate("Invalid regex string \"%1%\": %2%")) % filename % e.what()).str());
             }
 
-            return std::pair<boost::filesystem::path, std::regex>(parent, reg);
-        }
+            auto pathRegex = std::make_shared<const std::pair<boost::filesystem::path, std::regex>>(parent, reg);
 
-        void CheckRegex(bool& result, const std::string& regexStr) const {
-            result = false;
+            std::lock_guard<std::mutex> guard(splitRegexMutex);
+            splitRegexCache.insert(std::make_pair(regex, pathRegex));
 
-            BOOST_LOG_TRIVIAL(trace) << "Checking to see if any files matching the regex \"" << regexStr << "\" exist.";
-
-            std::pair<boost::filesystem::path, std::regex> pathRegex = SplitRegex(regexStr);
-
-            if (_game == nullptr)
-                return;
-
-            //Now we have a valid parent path and a regex filename. Check that
-            //the parent path exists and is a directory.
+            return pathRegex;
+        }
 
-            boost::filesystem::path parent_path = _game->DataPath() / pathRegex.first;
+        // Gets the filenames in a directory relative to the Data folder. Each
+        // directory is only listed once until it is invalidated, so that
+        // regexes in the same directory don't each list it again.
+        std::shared_ptr<const std::vector<std::string>> ListDirectory(const std::string& directory) const {
+            // The Data folder snapshot outlives the evaluation, so doesn't
+            // need to be owned.
+            if (directory.empty() && _game->DataSnapshot().Covers(_game->DataPath()))
+                return std::shared_ptr<const std::vector<std::string>>(&_game->DataSnapshot().Filenames(), [](const std::vector<std::string>*) {});
+
+            auto cachedValue = _game->GetCachedDirectoryListing(directory);
+            if (cachedValue.second)
+                return cachedValue.first;
+
+            auto listing = std::make_shared<std::vector<std::string>>();
+            boost::filesystem::path parent_path = _game->DataPath() / directory;
             if (!boost::filesystem::exists(parent_path) || !boost::filesystem::is_directory(parent_path)) {
                 BOOST_LOG_TRIVIAL(trace) << "The path \"" << parent_path << "\" does not exist or is not a directory.";
-                return;
             }
-
-            for (boost::filesystem::directory_iterator itr(parent_path); itr != boost::filesystem::directory_iterator(); ++itr) {
-                if (std::regex_match(itr->path().filename().string(), pathRegex.second)) {
-                    result = true;
-                    BOOST_LOG_TRIVIAL(trace) << "Matching file found: " << itr->path();
-                    return;
+            else {
+                for (boost::filesystem::directory_iterator itr(parent_path); itr != boost::filesystem::directory_iterator(); ++itr) {
+                    listing->push_back(itr->path().filename().string());
                 }
             }
-        }
 
-        void CheckMany(bool& result, const std::string& regexStr) const {
-            result = false;
+            _game->CacheDirectoryListing(directory, listing);
 
-            BOOST_LOG_TRIVIAL(trace) << "Checking to see if more than one file matching the regex \"" << regexStr << "\" exist.";
+            return listing;
+        }
 
-            std::pair<boost::filesystem::path, std::regex> pathRegex = SplitRegex(regexStr);
+        // Counts the files matching the given regex, stopping at two matches
+        // because no condition function needs to tell any more apart.
+        size_t CountRegexMatches(const std::string& regexStr) const {
+            auto pathRegex = SplitRegex(regexStr);
+            std::string directory = pathRegex->first.string();
+
+            // regex() and many() share their match count, so record both as
+            // the same probe.
+            if (_probes != nullptr) {
+                _probes->insert("regex(\"" + regexStr + "\")");
+                return 0;
+            }
 
             if (_game == nullptr)
-                return;
+                return 0;
+
+            // The matches depend on the contents of the parent directory.
+            AddPathDependency(directory);
+
+            auto cachedValue = _game->GetCachedRegexMatches(regexStr);
+            if (cachedValue.second)
+                return cachedValue.first;
 
             //Now we have a valid parent path and a regex filename. Check that
             //the parent path exists and is a directory.
 
-            boost::filesystem::path parent_path = _game->DataPath() / pathRegex.first;
-            if (!boost::filesystem::exists(parent_path) || !boost::filesystem::is_directory(parent_path)) {
-                BOOST_LOG_TRIVIAL(trace) << "The path \"" << parent_path << "\" does not exist or is not a directory.";
-                return;
-            }
-
             size_t count = 0;
-            for (boost::filesystem::directory_iterator itr(parent_path); itr != boost::filesystem::directory_iterator(); ++itr) {
-                if (std::regex_match(itr->path().filename().string(), pathRegex.second)) {
+            std::shared_ptr<const std::vector<std::string>> listing = ListDirectory(directory);
+            for (const auto& filename : *listing) {
+                if (std::regex_match(filename, pathRegex->second)) {
                     ++count;
-                    BOOST_LOG_TRIVIAL(trace) << "Matching file found: " << itr->path();
+                    BOOST_LOG_TRIVIAL(trace) << "Matching file found: " << filename;
+                    if (count == 2)
+                        break;
                 }
             }
 
-            result = count > 1;
+            _game->CacheRegexMatches(regexStr, directory, count);
+
+            return count;
+        }
+
+        void CheckRegex(bool& result, const std::string& regexStr) const {
+            BOOST_LOG_TRIVIAL(trace) << "Checking to see if any files matching the regex \"" << regexStr << "\" exist.";
+
+            result = CountRegexMatches(regexStr) > 0;
+        }
+
+        void CheckMany(bool& result, const std::string& regexStr) const {
+            BOOST_LOG_TRIVIAL(trace) << "Checking to see if more than one file matching the regex \"" << regexStr << "\" exist.";
+
+            result = CountRegexMatches(regexStr) > 1;
         }
 
         void CheckSum(bool& result, const std::string& file, const uint32_t checksum) {
@@ -284,18 +358,24 @@ namespace loot {
                 throw loot::error(loot::error::invalid_args, boost::locale::translate("Invalid file path:").str() + " " + file);
             }
 
+            if (_probes != nullptr) {
+                _probes->insert("checksum(\"" + file + "\", 0)");
+                return;
+            }
+
             if (_game == nullptr)
                 return;
 
+            if (file != "LOOT")
+                AddPathDependency(file);
+
             uint32_t crc = _game->GetCachedCrc(file);
 
             if (crc == 0) {
                 if (file == "LOOT")
                     crc = GetCrc32(boost::filesystem::absolute("LOOT.exe"));
-                if (boost::filesystem::exists(_game->DataPath() / file))
-                    crc = GetCrc32(_game->DataPath() / file);
-                else if ((boost::iends_with(file, ".esp") || boost::iends_with(file, ".esm")) && boost::filesystem::exists(_game->DataPath() / (file + ".ghost")))
-                    crc = GetCrc32(_game->DataPath() / (file + ".ghost"));
+                if (_game->DataFileExists(file))
+                    crc = GetCrc32(_game->DataFilePath(file));
                 else {
                     result = false;
                     return;
@@ -312,6 +392,11 @@ namespace loot {
 
             CheckFile(result, file);
 
+            if (_probes != nullptr) {
+                _probes->insert("version(\"" + file + "\", \"0\", ==)");
+                return;
+            }
+
             if (_game == nullptr)
                 return;
 
@@ -324,14 +409,26 @@ namespace loot {
 
             Version givenVersion = Version(version);
             Version trueVersion;
-            if (file == "LOOT")
-                trueVersion = Version(boost::filesystem::absolute("LOOT.exe"));
-            else if (Plugin(file).IsValid(*_game)) {
-                Plugin plugin(*_game, file, true);
-                trueVersion = Version(plugin.Version());
+            auto cachedValue = _game->GetCachedVersion(file);
+            if (cachedValue.second)
+                trueVersion = Version(cachedValue.first);
+            else {
+                // Installed plugins will usually have been loaded already, so
+                // only parse files that haven't been.
+                auto pluginIt = _game->plugins.find(boost::locale::to_lower(file));
+                if (file == "LOOT")
+                    trueVersion = Version(boost::filesystem::absolute("LOOT.exe"));
+                else if (pluginIt != _game->plugins.end())
+                    trueVersion = Version(pluginIt->second.Version());
+                else if (Plugin(file).IsValid(*_game)) {
+                    Plugin plugin(*_game, file, true);
+                    trueVersion = Version(plugin.Version());
+                }
+                else
+                    trueVersion = Version(_game->DataPath() / file);
+
+                _game->CacheVersion(file, trueVersion.AsString());
             }
-            else
-                trueVersion = Version(_game->DataPath() / file);
 
             BOOST_LOG_TRIVIAL(trace) << "Version extracted: " << trueVersion.AsString();
 
@@ -355,6 +452,9 @@ namespace loot {
             if (_game == nullptr)
                 return;
 
+            if (_dependencies != nullptr)
+                _dependencies->activePlugins.insert(file);
+
             if (file == "LOOT")
                 result = false;
             else
@@ -390,5 +490,14 @@ namespace loot {
             return true;
         }
     };
+
+    template<typename Iterator, typename Skipper>
+    const std::regex ConditionGrammar<Iterator, Skipper>::separatorRegex("/|(\\\\\\\\)", std::regex::ECMAScript);
+
+    template<typename Iterator, typename Skipper>
+    std::unordered_map<std::string, std::shared_ptr<const std::pair<boost::filesystem::path, std::regex>>> ConditionGrammar<Iterator, Skipper>::splitRegexCache;
+
+    template<typename Iterator, typename Skipper>
+    std::mutex ConditionGrammar<Iterator, Skipper>::splitRegexMutex;
 }
 #endif
@@ -55,7 +55,8 @@ namespace loot {
         if (cachedValue.second)
             return cachedValue.first;
 
-        ConditionGrammar<std::string::const_iterator, boost::spirit::qi::space_type> grammar(&game);
+        CacheDependencies dependencies;
+        ConditionGrammar<std::string::const_iterator, boost::spirit::qi::space_type> grammar(&game, nullptr, &dependencies);
         boost::spirit::qi::space_type skipper;
         std::string::const_iterator begin, end;
         bool eval;
@@ -77,7 +78,7 @@ namespace loot {
             throw loot::error(loot::error::condition_eval_fail, (boost::format(lc::translate("Failed to parse condition \"%1%\".")) % _condition).str());
         }
 
-        game.CacheCondition(_condition, eval);
+        game.CacheCondition(_condition, eval, dependencies);
 
         return eval;
     }
@@ -109,4 +110,24 @@ namespace loot {
             throw loot::error(loot::error::condition_eval_fail, (boost::format(lc::translate("Failed to parse condition \"%1%\".")) % _condition).str());
         }
     }
+
+    void ConditionalMetadata::CollectProbes(std::set<std::string>& probes) const {
+        if (_condition.empty())
+            return;
+
+        ConditionGrammar<std::string::const_iterator, boost::spirit::qi::space_type> grammar(nullptr, &probes, nullptr);
+        boost::spirit::qi::space_type skipper;
+        std::string::const_iterator begin, end;
+
+        begin = _condition.begin();
+        end = _condition.end();
+
+        // Any syntax errors will be reported when the condition is evaluated.
+        try {
+            boost::spirit::qi::phrase_parse(begin, end, grammar, skipper);
+        }
+        catch (std::exception& e) {
+            BOOST_LOG_TRIVIAL(debug) << "Skipping probes for condition \"" << _condition << "\": " << e.what();
+        }
+    }
 }
@@ -24,6 +24,7 @@
 #ifndef __LOOT_METADATA_CONDITIONAL_METADATA__
 #define __LOOT_METADATA_CONDITIONAL_METADATA__
 
+#include <set>
 #include <string>
 
 namespace loot {
@@ -38,6 +39,11 @@ namespace loot {
         bool EvalCondition(Game& game) const;
         void ParseCondition() const;  // Throws error on parsing failure.
 
+        // Adds the filesystem-dependent function calls the condition makes to
+        // the given set, as conditions that can be evaluated in advance.
+        // Conditions that fail to parse are skipped.
+        void CollectProbes(std::set<std::string>& probes) const;
+
         std::string Condition() const;
     private:
         std::string _condition;
@@ -31,6 +31,7 @@
 #include <boost/log/trivial.hpp>
 #include <boost/format.hpp>
 #include <boost/locale.hpp>
+#include <algorithm>
 #include <regex>
 
 using namespace std;
@@ -57,35 +58,26 @@ namespace loot {
         }
 
         //Merge the following. If any files in the source already exist in the destination, they will be skipped. Files have display strings and condition strings which aren't considered when comparing them, so will be lost if the plugin being merged in has additional data in these strings.
-        std::set<File> files = plugin.LoadAfter();
-        loadAfter.insert(files.begin(), files.end());
-
-        files = plugin.Reqs();
-        requirements.insert(files.begin(), files.end());
-
-        files = plugin.Incs();
-        incompatibilities.insert(files.begin(), files.end());
+        //The sources are already sorted and unique, so each merge is a single linear pass.
+        loadAfter.insert(boost::container::ordered_unique_range, plugin.LoadAfter().begin(), plugin.LoadAfter().end());
+        requirements.insert(boost::container::ordered_unique_range, plugin.Reqs().begin(), plugin.Reqs().end());
+        incompatibilities.insert(boost::container::ordered_unique_range, plugin.Incs().begin(), plugin.Incs().end());
 
         //Merge Bash Tags too. Conditions are ignored during comparison, but if a tag is added and removed, both instances will be in the set.
-        std::set<Tag> bashTags = plugin.Tags();
-        tags.insert(bashTags.begin(), bashTags.end());
+        tags.insert(boost::container::ordered_unique_range, plugin.Tags().begin(), plugin.Tags().end());
 
         //Messages are in an ordered list, and should be fully merged.
-        std::list<Message> pMessages = plugin.Messages();
-        messages.insert(messages.end(), pMessages.begin(), pMessages.end());
+        messages.insert(messages.end(), plugin.Messages().begin(), plugin.Messages().end());
 
-        set<PluginDirtyInfo> dirtyInfo = plugin.DirtyInfo();
-        _dirtyInfo.insert(dirtyInfo.begin(), dirtyInfo.end());
-
-        set<Location> locations = plugin.Locations();
-        _locations.insert(locations.begin(), locations.end());
+        _dirtyInfo.insert(boost::container::ordered_unique_range, plugin.DirtyInfo().begin(), plugin.DirtyInfo().end());
+        _locations.insert(boost::container::ordered_unique_range, plugin.Locations().begin(), plugin.Locations().end());
 
         return;
     }
 
     PluginMetadata PluginMetadata::DiffMetadata(const PluginMetadata& plugin) const {
         BOOST_LOG_TRIVIAL(trace) << "Calculating metadata difference for: " << name;
-        PluginMetadata p(*this);
+        PluginMetadata p(MetadataHeader());
 
         if (priority == plugin.Priority()) {
             p.Priority(0);
@@ -93,94 +85,55 @@ namespace loot {
         }
 
         //Compare this plugin against the given plugin.
-        set<File> files = plugin.LoadAfter();
-        set<File> filesDiff;
-        set_symmetric_difference(loadAfter.begin(), loadAfter.end(), files.begin(), files.end(), inserter(filesDiff, filesDiff.begin()));
-        p.LoadAfter(filesDiff);
-
-        filesDiff.clear();
-        files = plugin.Reqs();
-        set_symmetric_difference(requirements.begin(), requirements.end(), files.begin(), files.end(), inserter(filesDiff, filesDiff.begin()));
-        p.Reqs(filesDiff);
-
-        filesDiff.clear();
-        files = plugin.Incs();
-        set_symmetric_difference(incompatibilities.begin(), incompatibilities.end(), files.begin(), files.end(), inserter(filesDiff, filesDiff.begin()));
-        p.Incs(filesDiff);
-
-        list<Message> msgs1 = plugin.Messages();
-        list<Message> msgs2 = messages;
-        msgs1.sort();
-        msgs2.sort();
-        list<Message> mDiff;
-        set_symmetric_difference(msgs2.begin(), msgs2.end(), msgs1.begin(), msgs1.end(), inserter(mDiff, mDiff.begin()));
-        p.Messages(mDiff);
-
-        set<Tag> bashTags = plugin.Tags();
-        set<Tag> tagDiff;
-        set_symmetric_difference(tags.begin(), tags.end(), bashTags.begin(), bashTags.end(), inserter(tagDiff, tagDiff.begin()));
-        p.Tags(tagDiff);
-
-        set<PluginDirtyInfo> dirtyInfo = plugin.DirtyInfo();
-        set<PluginDirtyInfo> dirtDiff;
-        set_symmetric_difference(_dirtyInfo.begin(), _dirtyInfo.end(), dirtyInfo.begin(), dirtyInfo.end(), inserter(dirtDiff, dirtDiff.begin()));
-        p.DirtyInfo(dirtDiff);
-
-        set<Location> locations = plugin.Locations();
-        set<Location> locationsDiff;
-        set_symmetric_difference(_locations.begin(), _locations.end(), locations.begin(), locations.end(), inserter(locationsDiff, locationsDiff.begin()));
-        p.Locations(locationsDiff);
+        set_symmetric_difference(loadAfter.begin(), loadAfter.end(), plugin.LoadAfter().begin(), plugin.LoadAfter().end(), inserter(p.loadAfter, p.loadAfter.end()));
+        set_symmetric_difference(requirements.begin(), requirements.end(), plugin.Reqs().begin(), plugin.Reqs().end(), inserter(p.requirements, p.requirements.end()));
+        set_symmetric_difference(incompatibilities.begin(), incompatibilities.end(), plugin.Incs().begin(), plugin.Incs().end(), inserter(p.incompatibilities, p.incompatibilities.end()));
+
+        vector<Message> msgs1(plugin.Messages());
+        vector<Message> msgs2(messages);
+        sort(msgs1.begin(), msgs1.end());
+        sort(msgs2.begin(), msgs2.end());
+        set_symmetric_difference(msgs2.begin(), msgs2.end(), msgs1.begin(), msgs1.end(), back_inserter(p.messages));
+
+        set_symmetric_difference(tags.begin(), tags.end(), plugin.Tags().begin(), plugin.Tags().end(), inserter(p.tags, p.tags.end()));
+        set_symmetric_difference(_dirtyInfo.begin(), _dirtyInfo.end(), plugin.DirtyInfo().begin(), plugin.DirtyInfo().end(), inserter(p._dirtyInfo, p._dirtyInfo.end()));
+        set_symmetric_difference(_locations.begin(), _locations.end(), plugin.Locations().begin(), plugin.Locations().end(), inserter(p._locations, p._locations.end()));
 
         return p;
     }
 
     PluginMetadata PluginMetadata::NewMetadata(const PluginMetadata& plugin) const {
         BOOST_LOG_TRIVIAL(trace) << "Comparing new metadata for: " << name;
-        PluginMetadata p(*this);
+        PluginMetadata p(MetadataHeader());
 
         //Compare this plugin against the given plugin.
-        set<File> files = plugin.LoadAfter();
-        set<File> filesDiff;
-        set_difference(loadAfter.begin(), loadAfter.end(), files.begin(), files.end(), inserter(filesDiff, filesDiff.begin()));
-        p.LoadAfter(filesDiff);
-
-        filesDiff.clear();
-        files = plugin.Reqs();
-        set_difference(requirements.begin(), requirements.end(), files.begin(), files.end(), inserter(filesDiff, filesDiff.begin()));
-        p.Reqs(filesDiff);
-
-        filesDiff.clear();
-        files = plugin.Incs();
-        set_difference(incompatibilities.begin(), incompatibilities.end(), files.begin(), files.end(), inserter(filesDiff, filesDiff.begin()));
-        p.Incs(filesDiff);
-
-        list<Message> msgs1 = plugin.Messages();
-        list<Message> msgs2 = messages;
-        msgs1.sort();
-        msgs2.sort();
-        list<Message> mDiff;
-        set_difference(msgs2.begin(), msgs2.end(), msgs1.begin(), msgs1.end(), inserter(mDiff, mDiff.begin()));
-        p.Messages(mDiff);
-
-        set<Tag> bashTags = plugin.Tags();
-        set<Tag> tagDiff;
-        set_difference(tags.begin(), tags.end(), bashTags.begin(), bashTags.end(), inserter(tagDiff, tagDiff.begin()));
-        p.Tags(tagDiff);
-
-        set<PluginDirtyInfo> dirtyInfo = plugin.DirtyInfo();
-        set<PluginDirtyInfo> dirtDiff;
-        set_difference(_dirtyInfo.begin(), _dirtyInfo.end(), dirtyInfo.begin(), dirtyInfo.end(), inserter(dirtDiff, dirtDiff.begin()));
-        p.DirtyInfo(dirtDiff);
-
-        set<Location> locations = plugin.Locations();
-        set<Location> locationsDiff;
-        set_difference(_locations.begin(), _locations.end(), locations.begin(), locations.end(), inserter(locationsDiff, locationsDiff.begin()));
-        p.Locations(locationsDiff);
+        set_difference(loadAfter.begin(), loadAfter.end(), plugin.LoadAfter().begin(), plugin.LoadAfter().end(), inserter(p.loadAfter, p.loadAfter.end()));
+        set_difference(requirements.begin(), requirements.end(), plugin.Reqs().begin(), plugin.Reqs().end(), inserter(p.requirements, p.requirements.end()));
+        set_difference(incompatibilities.begin(), incompatibilities.end(), plugin.Incs().begin(), plugin.Incs().end(), inserter(p.incompatibilities, p.incompatibilities.end()));
+
+        vector<Message> msgs1(plugin.Messages());
+        vector<Message> msgs2(messages);
+        sort(msgs1.begin(), msgs1.end());
+        sort(msgs2.begin(), msgs2.end());
+        set_difference(msgs2.begin(), msgs2.end(), msgs1.begin(), msgs1.end(), back_inserter(p.messages));
+
+        set_difference(tags.begin(), tags.end(), plugin.Tags().begin(), plugin.Tags().end(), inserter(p.tags, p.tags.end()));
+        set_difference(_dirtyInfo.begin(), _dirtyInfo.end(), plugin.DirtyInfo().begin(), plugin.DirtyInfo().end(), inserter(p._dirtyInfo, p._dirtyInfo.end()));
+        set_difference(_locations.begin(), _locations.end(), plugin.Locations().begin(), plugin.Locations().end(), inserter(p._locations, p._locations.end()));
+
+        return p;
+    }
 
+    PluginMetadata PluginMetadata::MetadataHeader() const {
+        PluginMetadata p;
+        p.name = name;
+        p.enabled = enabled;
+        p._isPriorityExplicit = _isPriorityExplicit;
+        p.priority = priority;
         return p;
     }
 
-    std::string PluginMetadata::Name() const {
+    const std::string& PluginMetadata::Name() const {
         return name;
     }
 
@@ -192,31 +145,31 @@ namespace loot {
         return priority;
     }
 
-    std::set<File> PluginMetadata::LoadAfter() const {
+    const boost::container::flat_set<File>& PluginMetadata::LoadAfter() const {
         return loadAfter;
     }
 
-    std::set<File> PluginMetadata::Reqs() const {
+    const boost::container::flat_set<File>& PluginMetadata::Reqs() const {
         return requirements;
     }
 
-    std::set<File> PluginMetadata::Incs() const {
+    const boost::container::flat_set<File>& PluginMetadata::Incs() const {
         return incompatibilities;
     }
 
-    std::list<Message> PluginMetadata::Messages() const {
+    const std::vector<Message>& PluginMetadata::Messages() const {
         return messages;
     }
 
-    std::set<Tag> PluginMetadata::Tags() const {
+    const boost::container::flat_set<Tag>& PluginMetadata::Tags() const {
         return tags;
     }
 
-    std::set<PluginDirtyInfo> PluginMetadata::DirtyInfo() const {
+    const boost::container::flat_set<PluginDirtyInfo>& PluginMetadata::DirtyInfo() const {
         return _dirtyInfo;
     }
 
-    std::set<Location> PluginMetadata::Locations() const {
+    const boost::container::flat_set<Location>& PluginMetadata::Locations() const {
         return _locations;
     }
 
@@ -232,52 +185,80 @@ namespace loot {
         priority = p;
     }
 
-    void PluginMetadata::LoadAfter(const std::set<File>& l) {
+    void PluginMetadata::LoadAfter(const boost::container::flat_set<File>& l) {
         loadAfter = l;
     }
 
-    void PluginMetadata::Reqs(const std::set<File>& r) {
+    void PluginMetadata::LoadAfter(boost::container::flat_set<File>&& l) {
+        loadAfter = std::move(l);
+    }
+
+    void PluginMetadata::Reqs(const boost::container::flat_set<File>& r) {
         requirements = r;
     }
 
-    void PluginMetadata::Incs(const std::set<File>& i) {
+    void PluginMetadata::Reqs(boost::container::flat_set<File>&& r) {
+        requirements = std::move(r);
+    }
+
+    void PluginMetadata::Incs(const boost::container::flat_set<File>& i) {
         incompatibilities = i;
     }
 
-    void PluginMetadata::Messages(const std::list<Message>& m) {
+    void PluginMetadata::Incs(boost::container::flat_set<File>&& i) {
+        incompatibilities = std::move(i);
+    }
+
+    void PluginMetadata::Messages(const std::vector<Message>& m) {
         messages = m;
     }
 
-    void PluginMetadata::Tags(const std::set<Tag>& t) {
+    void PluginMetadata::Messages(std::vector<Message>&& m) {
+        messages = std::move(m);
+    }
+
+    void PluginMetadata::Tags(const boost::container::flat_set<Tag>& t) {
         tags = t;
     }
 
-    void PluginMetadata::DirtyInfo(const std::set<PluginDirtyInfo>& dirtyInfo) {
+    void PluginMetadata::Tags(boost::container::flat_set<Tag>&& t) {
+        tags = std::move(t);
+    }
+
+    void PluginMetadata::DirtyInfo(const boost::container::flat_set<PluginDirtyInfo>& dirtyInfo) {
         _dirtyInfo = dirtyInfo;
     }
 
-    void PluginMetadata::Locations(const std::set<Location>& locations) {
+    void PluginMetadata::DirtyInfo(boost::container::flat_set<PluginDirtyInfo>&& dirtyInfo) {
+        _dirtyInfo = std::move(dirtyInfo);
+    }
+
+    void PluginMetadata::Locations(const boost::container::flat_set<Location>& locations) {
         _locations = locations;
     }
 
+    void PluginMetadata::Locations(boost::container::flat_set<Location>&& locations) {
+        _locations = std::move(locations);
+    }
+
     PluginMetadata& PluginMetadata::EvalAllConditions(Game& game, const unsigned int language) {
         for (auto it = loadAfter.begin(); it != loadAfter.end();) {
             if (!it->EvalCondition(game))
-                loadAfter.erase(it++);
+                it = loadAfter.erase(it);
             else
                 ++it;
         }
 
         for (auto it = requirements.begin(); it != requirements.end();) {
             if (!it->EvalCondition(game))
-                requirements.erase(it++);
+                it = requirements.erase(it);
             else
                 ++it;
         }
 
         for (auto it = incompatibilities.begin(); it != incompatibilities.end();) {
             if (!it->EvalCondition(game))
-                incompatibilities.erase(it++);
+                it = incompatibilities.erase(it);
             else
                 ++it;
         }
@@ -291,7 +272,7 @@ namespace loot {
 
         for (auto it = tags.begin(); it != tags.end();) {
             if (!it->EvalCondition(game))
-                tags.erase(it++);
+                it = tags.erase(it);
             else
                 ++it;
         }
@@ -304,11 +285,9 @@ namespace loot {
             //First need to get plugin's CRC, if it is an exact plugin and it does not have its CRC set.
             uint32_t crc = game.GetCachedCrc(name);
             if (crc == 0) {
-                if (boost::filesystem::exists(game.DataPath() / name)) {
-                    crc = GetCrc32(game.DataPath() / name);
-                }
-                else if (boost::filesystem::exists(game.DataPath() / (name + ".ghost"))) {
-                    crc = GetCrc32(game.DataPath() / (name + ".ghost"));
+                game.TrackPath(name);
+                if (game.DataFileExists(name)) {
+                    crc = GetCrc32(game.DataFilePath(name));
                 }
                 else {
                     // The plugin isn't installed, discard the dirty info.
@@ -323,7 +302,7 @@ namespace loot {
             // Now use the CRC to evaluate the dirty info.
             for (auto it = _dirtyInfo.begin(); it != _dirtyInfo.end();) {
                 if (it->CRC() != crc)
-                    _dirtyInfo.erase(it++);
+                    it = _dirtyInfo.erase(it);
                 else
                     ++it;
             }
@@ -332,6 +311,27 @@ namespace loot {
         return *this;
     }
 
+    void PluginMetadata::CollectProbes(std::set<std::string>& probes) const {
+        for (const auto& file : loadAfter)
+            file.CollectProbes(probes);
+
+        for (const auto& file : requirements)
+            file.CollectProbes(probes);
+
+        for (const auto& file : incompatibilities)
+            file.CollectProbes(probes);
+
+        for (const auto& message : messages)
+            message.CollectProbes(probes);
+
+        for (const auto& tag : tags)
+            tag.CollectProbes(probes);
+
+        // Dirty info is evaluated against the plugin's CRC.
+        if (!_dirtyInfo.empty() && !IsRegexPlugin())
+            probes.insert("checksum(\"" + name + "\", 0)");
+    }
+
     bool PluginMetadata::HasNameOnly() const {
         return !IsPriorityExplicit() && loadAfter.empty() && requirements.empty() && incompatibilities.empty() && messages.empty() && tags.empty() && _dirtyInfo.empty() && _locations.empty();
     }
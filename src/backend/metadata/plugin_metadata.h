@@ -34,10 +34,10 @@
 #include <cstdint>
 #include <string>
 #include <vector>
-#include <list>
 #include <set>
 #include <regex>
 
+#include <boost/container/flat_set.hpp>
 #include <boost/locale.hpp>
 
 #include <yaml-cpp/yaml.h>
@@ -66,29 +66,38 @@ namespace loot {
         //For 'priority', use 0 if the two plugin priorities are equal, and make it not explicit. Otherwise use this plugin's value.
         PluginMetadata NewMetadata(const PluginMetadata& plugin) const;
 
-        std::string Name() const;
+        const std::string& Name() const;
         bool Enabled() const;
         int Priority() const;
-        std::set<File> LoadAfter() const;
-        std::set<File> Reqs() const;
-        std::set<File> Incs() const;
-        std::list<Message> Messages() const;
-        std::set<Tag> Tags() const;
-        std::set<PluginDirtyInfo> DirtyInfo() const;
-        std::set<Location> Locations() const;
+        const boost::container::flat_set<File>& LoadAfter() const;
+        const boost::container::flat_set<File>& Reqs() const;
+        const boost::container::flat_set<File>& Incs() const;
+        const std::vector<Message>& Messages() const;
+        const boost::container::flat_set<Tag>& Tags() const;
+        const boost::container::flat_set<PluginDirtyInfo>& DirtyInfo() const;
+        const boost::container::flat_set<Location>& Locations() const;
 
         void Enabled(const bool enabled);
         void SetPriorityExplicit(bool state);
         void Priority(const int priority);
-        void LoadAfter(const std::set<File>& after);
-        void Reqs(const std::set<File>& reqs);
-        void Incs(const std::set<File>& incs);
-        void Messages(const std::list<Message>& messages);
-        void Tags(const std::set<Tag>& tags);
-        void DirtyInfo(const std::set<PluginDirtyInfo>& info);
-        void Locations(const std::set<Location>& locations);
+        void LoadAfter(const boost::container::flat_set<File>& after);
+        void LoadAfter(boost::container::flat_set<File>&& after);
+        void Reqs(const boost::container::flat_set<File>& reqs);
+        void Reqs(boost::container::flat_set<File>&& reqs);
+        void Incs(const boost::container::flat_set<File>& incs);
+        void Incs(boost::container::flat_set<File>&& incs);
+        void Messages(const std::vector<Message>& messages);
+        void Messages(std::vector<Message>&& messages);
+        void Tags(const boost::container::flat_set<Tag>& tags);
+        void Tags(boost::container::flat_set<Tag>&& tags);
+        void DirtyInfo(const boost::container::flat_set<PluginDirtyInfo>& info);
+        void DirtyInfo(boost::container::flat_set<PluginDirtyInfo>&& info);
+        void Locations(const boost::container::flat_set<Location>& locations);
+        void Locations(boost::container::flat_set<Location>&& locations);
 
         PluginMetadata& EvalAllConditions(Game& game, const unsigned int language);
+        // Collects the filesystem probes that EvalAllConditions() would make.
+        void CollectProbes(std::set<std::string>& probes) const;
         bool HasNameOnly() const;
         bool IsRegexPlugin() const;
         bool IsPriorityExplicit() const;
@@ -97,17 +106,20 @@ namespace loot {
         bool operator == (const PluginMetadata& rhs) const;
         bool operator != (const PluginMetadata& rhs) const;
     protected:
+        // Copies everything but the metadata sets and messages.
+        PluginMetadata MetadataHeader() const;
+
         std::string name;
         bool enabled;  //Default to true.
         bool _isPriorityExplicit;  //If false and priority is 0, then priority was not explicitly set as such.
         int priority;  //Default to 0 : >0 is lower down in load order, <0 is higher up.
-        std::set<File> loadAfter;
-        std::set<File> requirements;
-        std::set<File> incompatibilities;
-        std::list<Message> messages;
-        std::set<Tag> tags;
-        std::set<PluginDirtyInfo> _dirtyInfo;
-        std::set<Location> _locations;
+        boost::container::flat_set<File> loadAfter;
+        boost::container::flat_set<File> requirements;
+        boost::container::flat_set<File> incompatibilities;
+        std::vector<Message> messages;
+        boost::container::flat_set<Tag> tags;
+        boost::container::flat_set<PluginDirtyInfo> _dirtyInfo;
+        boost::container::flat_set<Location> _locations;
     };
 }
 
@@ -178,23 +190,23 @@ namespace YAML {
             }
 
             if (node["after"])
-                rhs.LoadAfter(node["after"].as< std::set<loot::File> >());
+                rhs.LoadAfter(node["after"].as< boost::container::flat_set<loot::File> >());
             if (node["req"])
-                rhs.Reqs(node["req"].as< std::set<loot::File> >());
+                rhs.Reqs(node["req"].as< boost::container::flat_set<loot::File> >());
             if (node["inc"])
-                rhs.Incs(node["inc"].as< std::set<loot::File> >());
+                rhs.Incs(node["inc"].as< boost::container::flat_set<loot::File> >());
             if (node["msg"])
-                rhs.Messages(node["msg"].as< std::list<loot::Message> >());
+                rhs.Messages(node["msg"].as< std::vector<loot::Message> >());
             if (node["tag"])
-                rhs.Tags(node["tag"].as< std::set<loot::Tag> >());
+                rhs.Tags(node["tag"].as< boost::container::flat_set<loot::Tag> >());
             if (node["dirty"]) {
                 if (rhs.IsRegexPlugin())
                     throw RepresentationException(node.Mark(), "bad conversion: 'dirty' key must not be present in a regex 'plugin metadata' object");
                 else
-                    rhs.DirtyInfo(node["dirty"].as< std::set<loot::PluginDirtyInfo> >());
+                    rhs.DirtyInfo(node["dirty"].as< boost::container::flat_set<loot::PluginDirtyInfo> >());
             }
             if (node["url"])
-                rhs.Locations(node["url"].as< std::set<loot::Location> >());
+                rhs.Locations(node["url"].as< boost::container::flat_set<loot::Location> >());
 
             return true;
         }
@@ -25,39 +25,244 @@
 #include "metadata_list.h"
 #include "globals.h"
 #include "error.h"
+#include "game/game.h"
 #include "helpers/streams.h"
 
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+
 #include <boost/algorithm/string.hpp>
 #include <boost/log/trivial.hpp>
 
+#include <yaml-cpp/eventhandler.h>
+
 using namespace std;
 
 namespace loot {
+    namespace {
+        // Builds a metadata list document from parser events. Each item of
+        // the top-level "plugins" sequence is passed to the given callback
+        // as soon as it has been parsed, rather than being kept in the
+        // document, so only one plugin entry is held as a node at a time.
+        // Anchored nodes are kept so that later aliases can use them.
+        class MetadataListEventHandler : public YAML::EventHandler {
+        public:
+            MetadataListEventHandler(std::function<void(const YAML::Node&)> onPlugin) : onPlugin(onPlugin) {}
+
+            const YAML::Node& Document() const {
+                return document;
+            }
+
+            virtual void OnDocumentStart(const YAML::Mark&) {}
+            virtual void OnDocumentEnd() {}
+
+            virtual void OnNull(const YAML::Mark&, YAML::anchor_t anchor) {
+                AddNode(YAML::Node(YAML::NodeType::Null), anchor);
+            }
+
+            virtual void OnAlias(const YAML::Mark&, YAML::anchor_t anchor) {
+                AddNode(anchors[anchor], YAML::NullAnchor);
+            }
+
+            virtual void OnScalar(const YAML::Mark&, const std::string& tag, YAML::anchor_t anchor, const std::string& value) {
+                YAML::Node node(value);
+                node.SetTag(tag);
+                AddNode(node, anchor);
+            }
+
+            virtual void OnSequenceStart(const YAML::Mark&, const std::string& tag, YAML::anchor_t anchor, YAML::EmitterStyle::value) {
+                // Only the root map's "plugins" value is streamed.
+                bool streamed = frames.size() == 1
+                    && frames.front().key
+                    && frames.front().key->IsScalar()
+                    && frames.front().key->Scalar() == "plugins";
+
+                StartFrame(YAML::Node(YAML::NodeType::Sequence), tag, anchor, streamed);
+            }
+
+            virtual void OnSequenceEnd() {
+                EndFrame();
+            }
+
+            virtual void OnMapStart(const YAML::Mark&, const std::string& tag, YAML::anchor_t anchor, YAML::EmitterStyle::value) {
+                StartFrame(YAML::Node(YAML::NodeType::Map), tag, anchor, false);
+            }
+
+            virtual void OnMapEnd() {
+                EndFrame();
+            }
+        private:
+            // Map keys are held by pointer because assigning to a Node
+            // that already refers to another node would overwrite it.
+            struct Frame {
+                YAML::Node node;
+                std::shared_ptr<YAML::Node> key;
+                bool streamed;
+            };
+
+            void StartFrame(YAML::Node node, const std::string& tag, YAML::anchor_t anchor, bool streamed) {
+                node.SetTag(tag);
+                if (anchor != YAML::NullAnchor)
+                    anchors[anchor] = node;
+
+                Frame frame;
+                frame.node = node;
+                frame.streamed = streamed;
+                frames.push_back(frame);
+            }
+
+            void EndFrame() {
+                Frame frame(frames.back());
+                frames.pop_back();
+                AddNode(frame.node, YAML::NullAnchor);
+            }
+
+            void AddNode(const YAML::Node& node, YAML::anchor_t anchor) {
+                if (anchor != YAML::NullAnchor)
+                    anchors[anchor] = node;
+
+                if (frames.empty()) {
+                    document = node;
+                    return;
+                }
+
+                Frame& parent = frames.back();
+                if (parent.node.IsSequence()) {
+                    if (parent.streamed)
+                        onPlugin(node);
+                    else
+                        parent.node.push_back(node);
+                }
+                else if (!parent.key)
+                    parent.key = make_shared<YAML::Node>(node);
+                else {
+                    parent.node[*parent.key] = node;
+                    parent.key.reset();
+                }
+            }
+
+            std::function<void(const YAML::Node&)> onPlugin;
+            YAML::Node document;
+            std::vector<Frame> frames;
+            std::unordered_map<YAML::anchor_t, YAML::Node> anchors;
+        };
+
+        // Plugin entries are decoded in batches of this size, with each
+        // thread given at least a minimum number of entries so that small
+        // lists aren't split up.
+        const size_t pluginBatchSize = 1024;
+        const size_t minPluginsPerThread = 64;
+
+        // Decodes the given plugin entry nodes on as many threads as are
+        // useful. Each entry's result or error is stored at its index.
+        void DecodePlugins(const vector<YAML::Node>& nodes, vector<PluginMetadata>& plugins, vector<exception_ptr>& errors) {
+            plugins.assign(nodes.size(), PluginMetadata());
+            errors.assign(nodes.size(), exception_ptr());
+
+            const vector<YAML::Node> * toDecode = &nodes;
+            auto decodeFrom = [&](size_t first, size_t step) {
+                for (size_t i = first; i < toDecode->size(); i += step) {
+                    try {
+                        plugins[i] = (*toDecode)[i].as<PluginMetadata>();
+                    }
+                    catch (...) {
+                        errors[i] = current_exception();
+                    }
+                }
+            };
+
+            // hardware_concurrency() may be zero, if so then use only one thread.
+            size_t threadsToUse = std::min((size_t)thread::hardware_concurrency(), nodes.size() / minPluginsPerThread);
+            if (threadsToUse <= 1) {
+                decodeFrom(0, 1);
+                return;
+            }
+
+            // Reading a yaml-cpp node can write to it, and entries can share
+            // nodes through aliases, so the threads decode deep copies that
+            // share nothing. The copies are made on this thread.
+            vector<YAML::Node> clones;
+            clones.reserve(nodes.size());
+            for (const auto& node : nodes) {
+                clones.push_back(YAML::Clone(node));
+            }
+            toDecode = &clones;
+
+            vector<thread> threads;
+            while (threads.size() < threadsToUse) {
+                threads.push_back(thread(decodeFrom, threads.size(), threadsToUse));
+            }
+
+            for (auto& thread : threads) {
+                if (thread.joinable())
+                    thread.join();
+            }
+        }
+    }
+
+    MetadataList::MetadataList()
+        : conditionGame(nullptr),
+        conditionLanguage(0),
+        lazyEvaluations(make_shared<LazyEvaluations>()) {}
+
     void MetadataList::Load(const boost::filesystem::path& filepath) {
-        plugins.clear();
-        regexPlugins.clear();
-        messages.clear();
+        clear();
 
         BOOST_LOG_TRIVIAL(debug) << "Loading file: " << filepath;
 
+        // Entries are decoded in parallel, but added in document order, so
+        // the first error reported is the same as if they had been decoded
+        // one at a time.
+        vector<YAML::Node> pendingNodes;
+        auto addPendingPlugins = [&]() {
+            vector<PluginMetadata> decoded;
+            vector<exception_ptr> errors;
+            DecodePlugins(pendingNodes, decoded, errors);
+            pendingNodes.clear();
+
+            for (size_t i = 0; i < decoded.size(); ++i) {
+                if (errors[i])
+                    rethrow_exception(errors[i]);
+
+                if (decoded[i].IsRegexPlugin())
+                    AddRegexPlugin(decoded[i]);
+                else {
+                    if (!InsertPlugin(decoded[i]))
+                        throw error(error::path_read_fail, "More than one entry exists for \"" + decoded[i].Name() + "\"");
+                }
+            }
+        };
+        auto addPlugin = [&](const YAML::Node& node) {
+            pendingNodes.push_back(node);
+            if (pendingNodes.size() == pluginBatchSize)
+                addPendingPlugins();
+        };
+
         loot::ifstream in(filepath);
-        YAML::Node metadataList = YAML::Load(in);
+        YAML::Parser parser(in);
+        MetadataListEventHandler handler(addPlugin);
+        parser.HandleNextDocument(handler);
         in.close();
 
+        const YAML::Node& metadataList = handler.Document();
+
+        // Streamed plugin entries aren't kept in the document, so this only
+        // finds entries that weren't given as a sequence.
         if (metadataList["plugins"]) {
             for (const auto& node : metadataList["plugins"]) {
-                PluginMetadata plugin(node.as<PluginMetadata>());
-                if (plugin.IsRegexPlugin())
-                    regexPlugins.push_back(plugin);
-                else {
-                    if (!plugins.insert(plugin).second)
-                        throw error(error::path_read_fail, "More than one entry exists for \"" + plugin.Name() + "\"");
-                }
+                addPlugin(node);
             }
         }
+        addPendingPlugins();
         if (metadataList["globals"])
             messages = metadataList["globals"].as< list<Message> >();
 
+        BuildCombinedRegex();
+
         BOOST_LOG_TRIVIAL(debug) << "File loaded successfully.";
     }
 
@@ -78,70 +283,249 @@ namespace loot {
     void MetadataList::clear() {
         plugins.clear();
         regexPlugins.clear();
+        regexPatterns.clear();
+        combinedRegex.reset();
         messages.clear();
+        conditionGame = nullptr;
+        evaluatedPlugins.clear();
+        lazyEvaluations = make_shared<LazyEvaluations>();
     }
 
     std::list<PluginMetadata> MetadataList::Plugins() const {
-        list<PluginMetadata> pluginList(plugins.begin(), plugins.end());
+        list<PluginMetadata> pluginList;
+        for (const auto& plugin : plugins) {
+            pluginList.push_back(*Evaluated(plugin.first, plugin.second));
+        }
 
-        pluginList.insert(pluginList.end(), regexPlugins.begin(), regexPlugins.end());
+        for (const auto& plugin : regexPlugins) {
+            pluginList.push_back(*plugin);
+        }
 
         return pluginList;
     }
 
+    void MetadataList::VisitPlugins(const std::function<bool(const PluginMetadata&)>& filter,
+                                    const std::function<void(const PluginMetadata&)>& visitor) const {
+        struct Entry {
+            string key;
+            const shared_ptr<const PluginMetadata> * plugin;
+            bool isRegex;
+        };
+
+        // Only the accepted entries are gathered and sorted.
+        vector<Entry> entries;
+        for (const auto& plugin : plugins) {
+            if (filter(*plugin.second)) {
+                Entry entry = { plugin.first, &plugin.second, false };
+                entries.push_back(entry);
+            }
+        }
+        for (const auto& plugin : regexPlugins) {
+            if (filter(*plugin)) {
+                Entry entry = { boost::locale::to_lower(plugin->Name()), &plugin, true };
+                entries.push_back(entry);
+            }
+        }
+
+        sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) {
+            return lhs.key < rhs.key;
+        });
+
+        // Regex entries are always evaluated in place.
+        for (const auto& entry : entries) {
+            if (entry.isRegex)
+                visitor(**entry.plugin);
+            else
+                visitor(*Evaluated(entry.key, *entry.plugin));
+        }
+    }
+
     // Merges multiple matching regex entries if any are found.
     PluginMetadata MetadataList::FindPlugin(const PluginMetadata& plugin) const {
         PluginMetadata match(plugin.Name());
 
-        auto it = plugins.find(plugin);
+        auto it = plugins.find(boost::locale::to_lower(plugin.Name()));
 
         if (it != plugins.end())
-            match = *it;
+            match = *Evaluated(it->first, it->second);
 
         // Now we want to also match possibly multiple regex entries.
-        auto regIt = find(regexPlugins.begin(), regexPlugins.end(), plugin);
-        while (regIt != regexPlugins.end()) {
-            match.MergeMetadata(*regIt);
-
-            regIt = find(++regIt, regexPlugins.end(), plugin);
+        if (plugin.IsRegexPlugin()) {
+            for (const auto& regexPlugin : regexPlugins) {
+                if (*regexPlugin == plugin)
+                    match.MergeMetadata(*regexPlugin);
+            }
+        }
+        else if (!regexPlugins.empty() && (!combinedRegex || regex_match(plugin.Name(), *combinedRegex))) {
+            auto patternIt = regexPatterns.begin();
+            for (auto regIt = regexPlugins.begin(); regIt != regexPlugins.end(); ++regIt, ++patternIt) {
+                // Entries that didn't compile are compared the slow way so
+                // that the regex error is still thrown.
+                bool matches = *patternIt ? regex_match(plugin.Name(), **patternIt) : **regIt == plugin;
+                if (matches)
+                    match.MergeMetadata(**regIt);
+            }
         }
 
         return match;
     }
 
     void MetadataList::AddPlugin(const PluginMetadata& plugin) {
-        if (plugin.IsRegexPlugin())
-            regexPlugins.push_back(plugin);
+        if (plugin.IsRegexPlugin()) {
+            AddRegexPlugin(plugin);
+            BuildCombinedRegex();
+        }
         else {
-            if (!plugins.insert(plugin).second)
+            if (!InsertPlugin(plugin))
                 throw error(error::invalid_args, "Cannot add \"" + plugin.Name() + "\" to the metadata list as another entry already exists.");
+
+            // Entries added after evaluation are used as given.
+            if (conditionGame != nullptr)
+                evaluatedPlugins.insert(boost::locale::to_lower(plugin.Name()));
         }
     }
 
     // Doesn't erase matching regex entries, because they might also
     // be required for other plugins.
     void MetadataList::ErasePlugin(const PluginMetadata& plugin) {
-        auto it = plugins.find(plugin);
+        auto it = plugins.find(boost::locale::to_lower(plugin.Name()));
 
         if (it != plugins.end()) {
+            evaluatedPlugins.erase(it->first);
             plugins.erase(it);
             return;
         }
     }
 
+    bool MetadataList::InsertPlugin(const PluginMetadata& plugin) {
+        string key(boost::locale::to_lower(plugin.Name()));
+        if (plugins.find(key) != plugins.end())
+            return false;
+
+        plugins.insert(make_pair(key, make_shared<const PluginMetadata>(plugin)));
+        return true;
+    }
+
+    void MetadataList::AddRegexPlugin(const PluginMetadata& plugin) {
+        regexPlugins.push_back(make_shared<const PluginMetadata>(plugin));
+        try {
+            regexPatterns.push_back(make_shared<const regex>(plugin.Name(), regex::ECMAScript | regex::icase));
+        }
+        catch (regex_error& e) {
+            BOOST_LOG_TRIVIAL(error) << "Invalid regex plugin entry \"" << plugin.Name() << "\": " << e.what();
+            regexPatterns.push_back(nullptr);
+        }
+    }
+
+    void MetadataList::BuildCombinedRegex() {
+        combinedRegex.reset();
+        if (regexPlugins.empty())
+            return;
+
+        // Backreferences would be renumbered by the grouping, so entries
+        // that use them can't be combined.
+        static const regex backreference("\\\\[1-9]");
+        string combined;
+        auto patternIt = regexPatterns.begin();
+        for (auto regIt = regexPlugins.begin(); regIt != regexPlugins.end(); ++regIt, ++patternIt) {
+            if (!*patternIt || regex_search((*regIt)->Name(), backreference))
+                return;
+
+            if (!combined.empty())
+                combined += '|';
+            combined += "(?:" + (*regIt)->Name() + ")";
+        }
+
+        try {
+            combinedRegex = make_shared<const regex>(combined, regex::ECMAScript | regex::icase | regex::nosubs);
+        }
+        catch (regex_error& e) {
+            BOOST_LOG_TRIVIAL(debug) << "Unable to combine regex plugin entries: " << e.what();
+        }
+    }
+
     void MetadataList::EvalAllConditions(Game& game, const unsigned int language) {
-        unordered_set<PluginMetadata> replacementSet;
-        for (auto &plugin : plugins) {
-            PluginMetadata p(plugin);
-            p.EvalAllConditions(game, language);
-            replacementSet.insert(p);
+        conditionGame = &game;
+        conditionLanguage = language;
+        evaluatedPlugins.clear();
+        lazyEvaluations = make_shared<LazyEvaluations>();
+
+        // Most entries are for plugins that aren't installed, so only the
+        // entries for installed plugins are evaluated now. Evaluated entries
+        // replace the shared originals, which other copies of this list
+        // may still be using. Entries with only a name can't change.
+        for (const auto& key : InstalledPluginKeys(game)) {
+            auto it = plugins.find(key);
+            if (it != plugins.end()) {
+                if (!it->second->HasNameOnly()) {
+                    PluginMetadata plugin(*it->second);
+                    it->second = make_shared<const PluginMetadata>(plugin.EvalAllConditions(game, language));
+                }
+                evaluatedPlugins.insert(it->first);
+            }
         }
-        plugins = replacementSet;
-        for (auto &plugin : regexPlugins) {
-            plugin.EvalAllConditions(game, language);
+        for (auto &regexPlugin : regexPlugins) {
+            PluginMetadata plugin(*regexPlugin);
+            regexPlugin = make_shared<const PluginMetadata>(plugin.EvalAllConditions(game, language));
         }
         for (auto &message : messages) {
             message.EvalCondition(game, language);
         }
     }
+
+    void MetadataList::CollectProbes(std::set<std::string>& probes, const Game& game) const {
+        for (const auto &key : InstalledPluginKeys(game)) {
+            auto it = plugins.find(key);
+            if (it != plugins.end())
+                it->second->CollectProbes(probes);
+        }
+        for (const auto &plugin : regexPlugins) {
+            plugin->CollectProbes(probes);
+        }
+        for (const auto &message : messages) {
+            message.CollectProbes(probes);
+        }
+    }
+
+    std::shared_ptr<const PluginMetadata> MetadataList::Evaluated(const std::string& key, const std::shared_ptr<const PluginMetadata>& plugin) const {
+        if (conditionGame == nullptr || evaluatedPlugins.count(key) != 0)
+            return plugin;
+
+        // The memo is only used if it was made from the same entry, since
+        // copies of this list may have replaced it since.
+        {
+            lock_guard<mutex> guard(lazyEvaluations->mutex);
+            auto it = lazyEvaluations->plugins.find(key);
+            if (it != lazyEvaluations->plugins.end() && it->second.first == plugin)
+                return it->second.second;
+        }
+
+        PluginMetadata evaluated(*plugin);
+        evaluated.EvalAllConditions(*conditionGame, conditionLanguage);
+        shared_ptr<const PluginMetadata> result(make_shared<const PluginMetadata>(evaluated));
+
+        lock_guard<mutex> guard(lazyEvaluations->mutex);
+        lazyEvaluations->plugins[key] = make_pair(plugin, result);
+        return result;
+    }
+
+    std::unordered_set<std::string> MetadataList::InstalledPluginKeys(const Game& game) {
+        unordered_set<string> keys;
+        for (const auto& plugin : game.plugins) {
+            keys.insert(plugin.first);
+        }
+
+        // Plugins don't need to have been loaded to be installed.
+        if (game.DataSnapshot().Covers(game.DataPath())) {
+            for (const auto& filename : game.DataSnapshot().Filenames()) {
+                string name(filename);
+                if (boost::iends_with(name, ".ghost"))
+                    name = name.substr(0, name.length() - 6);
+                if (boost::iends_with(name, ".esp") || boost::iends_with(name, ".esm"))
+                    keys.insert(boost::locale::to_lower(name));
+            }
+        }
+
+        return keys;
+    }
 }
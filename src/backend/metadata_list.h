@@ -27,8 +27,14 @@
 
 #include "metadata/plugin_metadata.h"
 
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <set>
 #include <string>
 #include <vector>
+#include <unordered_map>
 #include <unordered_set>
 
 #include <boost/filesystem.hpp>
@@ -48,12 +54,21 @@ namespace loot {
 
     class MetadataList {
     public:
+        MetadataList();
+
         void Load(const boost::filesystem::path& filepath);
         void Save(const boost::filesystem::path& filepath);
         void clear();
 
         std::list<PluginMetadata> Plugins() const;
 
+        // Calls visitor with each entry that filter accepts, in order of
+        // lowercased name. The filter is given the entries before they are
+        // evaluated, so only accepted entries are evaluated, and entries
+        // that don't need evaluating are visited without being copied.
+        void VisitPlugins(const std::function<bool(const PluginMetadata&)>& filter,
+                          const std::function<void(const PluginMetadata&)>& visitor) const;
+
         // Merges multiple matching regex entries if any are found.
         PluginMetadata FindPlugin(const PluginMetadata& plugin) const;
         void AddPlugin(const PluginMetadata& plugin);
@@ -62,13 +77,62 @@ namespace loot {
         // be required for other plugins.
         void ErasePlugin(const PluginMetadata& plugin);
 
-        // Eval plugin conditions.
+        // Eval plugin conditions. Global messages, regex entries and the
+        // entries for plugins loaded or installed in the game are evaluated
+        // in place. Other entries are evaluated the first time they are
+        // looked up, so the game must outlive any lookups, and lookups can
+        // throw evaluation errors.
         void EvalAllConditions(Game& game, const unsigned int language);
 
+        // Collects the distinct filesystem probes made by the conditions
+        // that EvalAllConditions() evaluates up front, so that they can be
+        // evaluated in advance.
+        void CollectProbes(std::set<std::string>& probes, const Game& game) const;
+
+        // Collects the names of the Bash Tags in every entry, whether or
+        // not their conditions would be met. Entries are not evaluated.
+        void CollectTagNames(std::set<std::string>& tagNames) const;
+
         std::list<Message> messages;
     protected:
-        std::unordered_set<PluginMetadata> plugins;
-        std::list<PluginMetadata> regexPlugins;
+        // Entries are immutable and shared between copies of a list, so
+        // copying a list only copies pointers. Changing an entry replaces
+        // it. Keyed by lowercased plugin name.
+        std::unordered_map<std::string, std::shared_ptr<const PluginMetadata>> plugins;
+        std::list<std::shared_ptr<const PluginMetadata>> regexPlugins;
+
+        bool InsertPlugin(const PluginMetadata& plugin);
+        void AddRegexPlugin(const PluginMetadata& plugin);
+        void BuildCombinedRegex();
+    private:
+        // Set by EvalAllConditions(). Entries that haven't been evaluated
+        // are evaluated against the game when looked up.
+        Game * conditionGame;
+        unsigned int conditionLanguage;
+        std::unordered_set<std::string> evaluatedPlugins;
+
+        // Entries evaluated when looked up, kept so that each is only
+        // evaluated once. Keyed like plugins, with the entry that was
+        // evaluated and the result. Shared by copies of the list until it
+        // is next evaluated.
+        struct LazyEvaluations {
+            std::mutex mutex;
+            std::unordered_map<std::string, std::pair<std::shared_ptr<const PluginMetadata>, std::shared_ptr<const PluginMetadata>>> plugins;
+        };
+        std::shared_ptr<LazyEvaluations> lazyEvaluations;
+
+        std::shared_ptr<const PluginMetadata> Evaluated(const std::string& key, const std::shared_ptr<const PluginMetadata>& plugin) const;
+
+        // Gets the lowercased names of the plugins loaded in the game or
+        // found in its Data folder snapshot.
+        static std::unordered_set<std::string> InstalledPluginKeys(const Game& game);
+
+        // The names of regex entries, compiled once in the same order as
+        // regexPlugins. Entries that fail to compile are null.
+        std::vector<std::shared_ptr<const std::regex>> regexPatterns;
+        // All the regex entry names as one alternation, used to skip
+        // plugins that match none of them. Null if it couldn't be built.
+        std::shared_ptr<const std::regex> combinedRegex;
     };
 }
 
@@ -99,11 +99,8 @@ namespace loot {
     Plugin::Plugin(loot::Game& game, const std::string& n, const bool headerOnly)
         : PluginMetadata(n), _isEmpty(true), isMaster(false), crc(0), numOverrideRecords(0) {
         try {
-            boost::filesystem::path filepath = game.DataPath() / name;
-
             // In case the plugin is ghosted.
-            if (!boost::filesystem::exists(filepath) && boost::filesystem::exists(filepath.string() + ".ghost"))
-                filepath += ".ghost";
+            boost::filesystem::path filepath = game.DataFilePath(name);
 
             libespm::Plugin plugin(game.LibespmId());
             plugin.load(filepath, headerOnly);
@@ -115,6 +112,7 @@ namespace loot {
 
             if (!headerOnly) {
                 BOOST_LOG_TRIVIAL(trace) << name << ": Caching CRC value.";
+                game.TrackPath(name);
                 crc = GetCrc32(filepath);
                 game.CacheCrc(name, crc);
             }
@@ -232,11 +230,8 @@ namespace loot {
         if (!boost::iends_with(name, ".esm") && !boost::iends_with(name, ".esp"))
             return false;
 
-        boost::filesystem::path filepath = game.DataPath() / name;
-
         // In case the plugin is ghosted.
-        if (!boost::filesystem::exists(filepath) && boost::filesystem::exists(filepath.string() + ".ghost"))
-            filepath += ".ghost";
+        boost::filesystem::path filepath = game.DataFilePath(name);
 
         if (libespm::Plugin::isValid(filepath, game.LibespmId(), true))
             return true;
@@ -261,8 +256,7 @@ namespace loot {
         BOOST_LOG_TRIVIAL(trace) << "Checking that the current install is valid according to " << name << "'s data.";
         if (IsActive(game)) {
             auto pluginExists = [](const Game& game, const std::string& file) {
-                return boost::filesystem::exists(game.DataPath() / file)
-                    || ((boost::iends_with(file, ".esp") || boost::iends_with(file, ".esm")) && boost::filesystem::exists(game.DataPath() / (file + ".ghost")));
+                return game.DataFileExists(file);
             };
             if (tags.find(Tag("Filter")) == tags.end()) {
                 for (const auto &master : masters) {
@@ -304,12 +298,19 @@ namespace loot {
             return false;
         if (game.Id() == Game::tes5 || game.Id() == Game::fo4) {
             // Skyrim plugins only load BSAs that exactly match their basename.
-            return boost::filesystem::exists(game.DataPath() / (name.substr(0, name.length() - 3) + "bsa"));
+            return game.DataFileExists(name.substr(0, name.length() - 3) + "bsa");
         }
         else {
             //Oblivion .esp files and FO3, FNV plugins can load BSAs which begin with the plugin basename.
             if (game.Id() != Game::tes4 || boost::iends_with(name, ".esp")) {
                 string basename = name.substr(0, name.length() - 4);
+                if (game.DataSnapshot().Covers(game.DataPath())) {
+                    for (const auto& filename : game.DataSnapshot().Filenames()) {
+                        if (boost::ends_with(filename, ".bsa") && boost::istarts_with(filename, basename))
+                            return true;
+                    }
+                    return false;
+                }
                 for (boost::filesystem::directory_iterator it(game.DataPath()); it != boost::filesystem::directory_iterator(); ++it) {
                     if (it->path().extension().string() == ".bsa" && boost::istarts_with(it->path().filename().string(), basename))
                         return true;
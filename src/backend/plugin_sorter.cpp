@@ -96,11 +96,13 @@ namespace loot {
 
     std::list<Plugin> PluginSorter::Sort(Game& game,
                                          const unsigned int language,
-                                         std::function<void(const std::string&)> progressCallback) {
+                                         std::function<void(const std::string&)> progressCallback,
+                                         const CancellationToken& cancellation) {
         // Clear existing data.
         graph.clear();
         indexMap.clear();
         oldLoadOrder.clear();
+        this->cancellation = cancellation;
 
         progressCallback(boost::locale::translate("Building plugin graph..."));
         BuildPluginGraph(game, language);
@@ -129,6 +131,7 @@ namespace loot {
         AddTieBreakEdges();
 
         BOOST_LOG_TRIVIAL(info) << "Checking to see if the graph is cyclic.";
+        cancellation.ThrowIfCancelled();
         CheckForCycles();
 
         //Now we can sort.
@@ -184,6 +187,7 @@ namespace loot {
         }
 
         for (const auto &plugin : pluginNames) {
+            cancellation.ThrowIfCancelled();
             vertex_t v = boost::add_vertex(game.plugins.find(plugin)->second, graph);
             BOOST_LOG_TRIVIAL(trace) << "Merging for plugin \"" << graph[v].Name() << "\"";
 
@@ -206,9 +210,9 @@ namespace loot {
             }
             catch (std::exception& e) {
                 BOOST_LOG_TRIVIAL(error) << "\"" << graph[v].Name() << "\" contains a condition that could not be evaluated. Details: " << e.what();
-                list<Message> messages(graph[v].Messages());
+                vector<Message> messages(graph[v].Messages());
                 messages.push_back(loot::Message(loot::Message::error, (boost::format(boost::locale::translate("\"%1%\" contains a condition that could not be evaluated. Details: %2%")) % graph[v].Name() % e.what()).str()));
-                graph[v].Messages(messages);
+                graph[v].Messages(std::move(messages));
             }
 
             //Also check install validity.
@@ -259,6 +263,7 @@ namespace loot {
         //Add edges for all relationships that aren't overlaps or priority differences.
         loot::vertex_it vit, vitend;
         for (boost::tie(vit, vitend) = boost::vertices(graph); vit != vitend; ++vit) {
+            cancellation.ThrowIfCancelled();
             vertex_t parentVertex;
             int parentPriority = graph[*vit].Priority();
 
@@ -308,8 +313,7 @@ namespace loot {
                 }
             }
             BOOST_LOG_TRIVIAL(trace) << "Adding in-edges for requirements.";
-            set<File> fileset(graph[*vit].Reqs());
-            for (const auto &file : fileset) {
+            for (const auto &file : graph[*vit].Reqs()) {
                 if (GetVertexByName(file.Name(), parentVertex) &&
                     !boost::edge(parentVertex, *vit, graph).second) {
                     BOOST_LOG_TRIVIAL(trace) << "Adding edge from \"" << graph[parentVertex].Name() << "\" to \"" << graph[*vit].Name() << "\".";
@@ -324,8 +328,7 @@ namespace loot {
             }
 
             BOOST_LOG_TRIVIAL(trace) << "Adding in-edges for 'load after's.";
-            fileset = graph[*vit].LoadAfter();
-            for (const auto &file : fileset) {
+            for (const auto &file : graph[*vit].LoadAfter()) {
                 if (GetVertexByName(file.Name(), parentVertex) &&
                     !boost::edge(parentVertex, *vit, graph).second) {
                     BOOST_LOG_TRIVIAL(trace) << "Adding edge from \"" << graph[parentVertex].Name() << "\" to \"" << graph[*vit].Name() << "\".";
@@ -352,6 +355,7 @@ namespace loot {
         loot::vertex_it vit, vitend;
 
         for (boost::tie(vit, vitend) = boost::vertices(graph); vit != vitend; ++vit) {
+            cancellation.ThrowIfCancelled();
             BOOST_LOG_TRIVIAL(trace) << "Adding priority difference edges to vertex for \"" << graph[*vit].Name() << "\".";
             //Priority differences should only be taken account between plugins that conflict.
             //However, an exception is made for plugins that contain only a header record,
@@ -397,6 +401,7 @@ namespace loot {
         loot::vertex_it vit, vitend;
 
         for (boost::tie(vit, vitend) = boost::vertices(graph); vit != vitend; ++vit) {
+            cancellation.ThrowIfCancelled();
             BOOST_LOG_TRIVIAL(trace) << "Adding overlap edges to vertex for \"" << graph[*vit].Name() << "\".";
 
             if (graph[*vit].NumOverrideFormIDs() == 0) {
@@ -426,6 +431,9 @@ namespace loot {
                         continue;
                     }
 
+                    // Each cycle check searches the graph, so check for
+                    // cancellation before every one.
+                    cancellation.ThrowIfCancelled();
                     //BOOST_LOG_TRIVIAL(trace) << "Checking edge validity between \"" << graph[*vit].Name() << "\" and \"" << graph[*vit2].Name() << "\".";
                     if (!EdgeCreatesCycle(parentVertex, vertex)) {  //No edge going the other way, OK to add this edge.
                         BOOST_LOG_TRIVIAL(trace) << "Adding edge from \"" << graph[parentVertex].Name() << "\" to \"" << graph[vertex].Name() << "\".";
@@ -483,6 +491,7 @@ namespace loot {
         // Use existing load order to decide the direction of these edges.
         loot::vertex_it vit, vitend;
         for (boost::tie(vit, vitend) = boost::vertices(graph); vit != vitend; ++vit) {
+            cancellation.ThrowIfCancelled();
             BOOST_LOG_TRIVIAL(trace) << "Adding tie-break edges to vertex for \"" << graph[*vit].Name() << "\".";
 
             loot::vertex_it vit2, vitend2;
@@ -501,6 +510,7 @@ namespace loot {
                     vertex = *vit;
                 }
 
+                cancellation.ThrowIfCancelled();
                 //BOOST_LOG_TRIVIAL(trace) << "Checking edge validity between \"" << graph[*vit].Name() << "\" and \"" << graph[*vit2].Name() << "\".";
                 if (!EdgeCreatesCycle(parentVertex, vertex)) {  //No edge going the other way, OK to add this edge.
                     BOOST_LOG_TRIVIAL(trace) << "Adding edge from \"" << graph[parentVertex].Name() << "\" to \"" << graph[vertex].Name() << "\".";
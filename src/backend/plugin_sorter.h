@@ -25,6 +25,7 @@
 #ifndef __LOOT_GRAPH__
 #define __LOOT_GRAPH__
 
+#include "helpers/cancellation.h"
 #include "plugin/plugin.h"
 
 #include <map>
@@ -41,11 +42,15 @@ namespace loot {
 
     class PluginSorter {
     public:
+        // Throws an error with the cancelled code if the given token is
+        // cancelled before sorting finishes.
         std::list<Plugin> Sort(Game& game,
                                const unsigned int language,
-                               std::function<void(const std::string&)> progressCallback);
+                               std::function<void(const std::string&)> progressCallback,
+                               const CancellationToken& cancellation = CancellationToken());
     private:
         PluginGraph graph;
+        CancellationToken cancellation;
         std::map<vertex_t, size_t> indexMap;
         vertex_map_t vertexIndexMap;
         std::list<std::string> oldLoadOrder;
@@ -519,20 +519,20 @@ namespace loot {
         // currently exists.
         BOOST_LOG_TRIVIAL(trace) << "Recording metadata lists from Javascript variables.";
         if (pluginMetadata["userlist"]["after"])
-            newUserlistEntry.LoadAfter(pluginMetadata["userlist"]["after"].as<set<File>>());
+            newUserlistEntry.LoadAfter(pluginMetadata["userlist"]["after"].as<boost::container::flat_set<File>>());
         if (pluginMetadata["userlist"]["req"])
-            newUserlistEntry.Reqs(pluginMetadata["userlist"]["req"].as<set<File>>());
+            newUserlistEntry.Reqs(pluginMetadata["userlist"]["req"].as<boost::container::flat_set<File>>());
         if (pluginMetadata["userlist"]["inc"])
-            newUserlistEntry.Incs(pluginMetadata["userlist"]["inc"].as<set<File>>());
+            newUserlistEntry.Incs(pluginMetadata["userlist"]["inc"].as<boost::container::flat_set<File>>());
 
         if (pluginMetadata["userlist"]["msg"])
-            newUserlistEntry.Messages(pluginMetadata["userlist"]["msg"].as<list<Message>>());
+            newUserlistEntry.Messages(pluginMetadata["userlist"]["msg"].as<vector<Message>>());
         if (pluginMetadata["userlist"]["tag"])
-            newUserlistEntry.Tags(pluginMetadata["userlist"]["tag"].as<set<Tag>>());
+            newUserlistEntry.Tags(pluginMetadata["userlist"]["tag"].as<boost::container::flat_set<Tag>>());
         if (pluginMetadata["userlist"]["dirty"])
-            newUserlistEntry.DirtyInfo(pluginMetadata["userlist"]["dirty"].as<set<PluginDirtyInfo>>());
+            newUserlistEntry.DirtyInfo(pluginMetadata["userlist"]["dirty"].as<boost::container::flat_set<PluginDirtyInfo>>());
         if (pluginMetadata["userlist"]["url"])
-            newUserlistEntry.Locations(pluginMetadata["userlist"]["url"].as<set<Location>>());
+            newUserlistEntry.Locations(pluginMetadata["userlist"]["url"].as<boost::container::flat_set<Location>>());
 
         // For cleanliness, only data that does not duplicate masterlist and plugin data should be retained, so diff that.
         BOOST_LOG_TRIVIAL(trace) << "Removing any user metadata that duplicates masterlist metadata.";
@@ -638,10 +638,10 @@ namespace loot {
 
             SendProgressUpdate(frame, loc::translate("Loading plugin headers..."));
 
-            // First clear CRC and condition caches, otherwise they could lead to incorrect evaluations.
-            _lootState.CurrentGame().ClearCache();
-
-            // Also refresh active plugins list.
+            // Refresh the active plugins list, which invalidates conditions
+            // on any plugins that have been activated or deactivated. Loading
+            // the plugins refreshes the Data folder snapshot and discards
+            // cached CRCs and condition results that depend on changed paths.
             _lootState.CurrentGame().RefreshActivePluginsList();
 
             bool isFirstLoad = _lootState.CurrentGame().plugins.empty();
@@ -664,7 +664,10 @@ namespace loot {
                     SendProgressUpdate(frame, loc::translate("Parsing masterlist..."));
                     BOOST_LOG_TRIVIAL(debug) << "Parsing masterlist.";
                     try {
-                        _lootState.CurrentGame().masterlist.Load(_lootState.CurrentGame().MasterlistPath());
+                        // The masterlist is in LOOT's own folder for the
+                        // game, so its binary cache is kept beside it.
+                        _lootState.CurrentGame().masterlist.Load(_lootState.CurrentGame().MasterlistPath(),
+                                                                 _lootState.CurrentGame().MasterlistPath().parent_path());
                     }
                     catch (exception &e) {
                         parsingErrors.push_back(Message(Message::error, (boost::format(loc::translate(
@@ -723,6 +726,16 @@ namespace loot {
 
             // Now store plugin data.
             SendProgressUpdate(frame, loc::translate("Merging and evaluating plugin metadata..."));
+
+            // Run the filesystem checks made by the installed plugins'
+            // conditions in parallel before evaluating them one by one.
+            set<string> probes;
+            for (const auto& plugin : installed) {
+                _lootState.CurrentGame().masterlist.FindPlugin(plugin).CollectProbes(probes);
+                _lootState.CurrentGame().userlist.FindPlugin(plugin).CollectProbes(probes);
+            }
+            _lootState.CurrentGame().EvalConditionProbes(probes);
+
             for (const auto& plugin : installed) {
                 /* Each plugin has members while hold its raw masterlist and userlist data for
                    the editor, and also processed data for the main display.
@@ -863,7 +876,8 @@ namespace loot {
                 else {
                     // Error wasn't a parsing error. Need to try parsing masterlist if it exists.
                     try {
-                        _lootState.CurrentGame().masterlist.Load(_lootState.CurrentGame().MasterlistPath());
+                        _lootState.CurrentGame().masterlist.Load(_lootState.CurrentGame().MasterlistPath(),
+                                                                 _lootState.CurrentGame().MasterlistPath().parent_path());
                     }
                     catch (...) {}
                 }
@@ -873,6 +887,10 @@ namespace loot {
             // Now regenerate the JS-side masterlist data if the masterlist was changed.
             SendProgressUpdate(frame, loc::translate("Regenerating displayed content..."));
             if (wasChanged) {
+                // The Data folder may have changed since the game's data was
+                // loaded, so refresh its snapshot before re-evaluating.
+                _lootState.CurrentGame().InvalidateChangedPaths();
+
                 // The data structure is to be set as 'loot.game'.
                 YAML::Node gameNode;
 
@@ -990,7 +1008,7 @@ namespace loot {
         BOOST_LOG_TRIVIAL(info) << "Using message language: " << Language(language).Name();
 
         try {
-            // Always reload all the plugins.
+            // Reload any plugins that have changed since they were last loaded.
             SendProgressUpdate(frame, loc::translate("Loading plugin contents..."));
             _lootState.CurrentGame().LoadPlugins(false);
 
@@ -1052,9 +1070,9 @@ namespace loot {
         }
         catch (std::exception& e) {
             BOOST_LOG_TRIVIAL(error) << "\"" << tempPlugin.Name() << "\" contains a condition that could not be evaluated. Details: " << e.what();
-            list<Message> messages(tempPlugin.Messages());
+            vector<Message> messages(tempPlugin.Messages());
             messages.push_back(Message(Message::error, (format(loc::translate("\"%1%\" contains a condition that could not be evaluated. Details: %2%")) % tempPlugin.Name() % e.what()).str()));
-            tempPlugin.Messages(messages);
+            tempPlugin.Messages(std::move(messages));
         }
 
         //Also check install validity.
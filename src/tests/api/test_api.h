@@ -29,6 +29,10 @@ along with LOOT.  If not, see
 #include "tests/fixtures.h"
 
 #include <boost/algorithm/string/predicate.hpp>
+#include <yaml-cpp/yaml.h>
+
+#include <atomic>
+#include <thread>
 
 TEST(GetVersion, HandlesNullInput) {
     unsigned int vMajor, vMinor, vPatch;
@@ -84,6 +88,20 @@ TEST(GetErrorMessage, HandlesInputCorrectly) {
     ASSERT_STREQ("Null message pointer passed.", error);
 }
 
+TEST(GetErrorMessage, ShouldBeSeparateForEachThread) {
+    EXPECT_EQ(loot_error_invalid_args, loot_get_error_message(NULL));
+
+    const char * otherError = "";
+    std::thread([&otherError]() {
+        loot_get_error_message(&otherError);
+    }).join();
+    EXPECT_EQ(nullptr, otherError);
+
+    const char * error;
+    EXPECT_EQ(loot_ok, loot_get_error_message(&error));
+    ASSERT_STREQ("Null message pointer passed.", error);
+}
+
 TEST(Cleanup, CleansUpAfterError) {
     // First generate an error.
     EXPECT_EQ(loot_error_invalid_args, loot_get_error_message(NULL));
@@ -383,6 +401,107 @@ TEST_F(OblivionAPIOperationsTest, SortPlugins) {
     EXPECT_EQ(expectedOrder, actualOrder);
 }
 
+TEST_F(OblivionAPIOperationsTest, InvalidatePlugins) {
+    EXPECT_EQ(loot_error_invalid_args, loot_invalidate_plugins(NULL));
+
+    char ** sortedPlugins;
+    size_t numPlugins;
+    ASSERT_EQ(loot_ok, loot_sort_plugins(db, &sortedPlugins, &numPlugins));
+    std::vector<std::string> expectedOrder(sortedPlugins, sortedPlugins + numPlugins);
+
+    // Sorting again should give the same result whether or not the plugins
+    // are reloaded.
+    ASSERT_EQ(loot_ok, loot_sort_plugins(db, &sortedPlugins, &numPlugins));
+    EXPECT_EQ(expectedOrder, std::vector<std::string>(sortedPlugins, sortedPlugins + numPlugins));
+
+    EXPECT_EQ(loot_ok, loot_invalidate_plugins(db));
+    ASSERT_EQ(loot_ok, loot_sort_plugins(db, &sortedPlugins, &numPlugins));
+    EXPECT_EQ(expectedOrder, std::vector<std::string>(sortedPlugins, sortedPlugins + numPlugins));
+}
+
+TEST_F(OblivionAPIOperationsTest, StartSortShouldGiveTheSameOrderAsSortPlugins) {
+    loot_sort_job job;
+    EXPECT_EQ(loot_error_invalid_args, loot_start_sort(NULL, NULL, NULL, &job));
+    EXPECT_EQ(loot_error_invalid_args, loot_start_sort(db, NULL, NULL, NULL));
+    EXPECT_EQ(loot_error_invalid_args, loot_cancel_sort(NULL));
+
+    char ** sortedPlugins;
+    size_t numPlugins;
+    EXPECT_EQ(loot_error_invalid_args, loot_wait_for_sort(NULL, &sortedPlugins, &numPlugins));
+    ASSERT_EQ(loot_ok, loot_sort_plugins(db, &sortedPlugins, &numPlugins));
+    std::vector<std::string> expectedOrder(sortedPlugins, sortedPlugins + numPlugins);
+
+    std::atomic<size_t> numProgressMessages(0);
+    ASSERT_EQ(loot_ok, loot_start_sort(db, [](const char * message, void * userData) {
+        ++*static_cast<std::atomic<size_t>*>(userData);
+    }, &numProgressMessages, &job));
+    EXPECT_EQ(loot_error_invalid_args, loot_wait_for_sort(job, NULL, &numPlugins));
+
+    EXPECT_EQ(loot_ok, loot_wait_for_sort(job, &sortedPlugins, &numPlugins));
+    EXPECT_EQ(expectedOrder, std::vector<std::string>(sortedPlugins, sortedPlugins + numPlugins));
+    EXPECT_LT(0, numProgressMessages);
+
+    // Waiting again should give the same result.
+    EXPECT_EQ(loot_ok, loot_wait_for_sort(job, &sortedPlugins, &numPlugins));
+    EXPECT_EQ(expectedOrder.size(), numPlugins);
+
+    loot_destroy_sort_job(job);
+}
+
+TEST_F(OblivionAPIOperationsTest, WaitForSortShouldBeCallableFromSeveralThreadsAtOnce) {
+    loot_sort_job job;
+    ASSERT_EQ(loot_ok, loot_start_sort(db, NULL, NULL, &job));
+
+    std::vector<std::thread> waiters;
+    std::vector<unsigned int> returnCodes(4, loot_error_invalid_args);
+    std::vector<size_t> sizes(4, 0);
+    for (size_t i = 0; i < returnCodes.size(); ++i) {
+        waiters.push_back(std::thread([&, i]() {
+            char ** sortedPlugins;
+            returnCodes[i] = loot_wait_for_sort(job, &sortedPlugins, &sizes[i]);
+        }));
+    }
+    for (auto& waiter : waiters)
+        waiter.join();
+
+    for (size_t i = 0; i < returnCodes.size(); ++i) {
+        EXPECT_EQ(loot_ok, returnCodes[i]);
+        EXPECT_EQ(11, sizes[i]);
+    }
+
+    loot_destroy_sort_job(job);
+}
+
+TEST_F(OblivionAPIOperationsTest, CancelSortShouldStopTheSort) {
+    // Cancel the sort from its first progress message, so that it is
+    // cancelled before it finishes.
+    std::atomic<loot_sort_job> startedJob(nullptr);
+    loot_sort_job job;
+    ASSERT_EQ(loot_ok, loot_start_sort(db, [](const char * message, void * userData) {
+        std::atomic<loot_sort_job>& job = *static_cast<std::atomic<loot_sort_job>*>(userData);
+        while (job == nullptr)
+            std::this_thread::yield();
+        loot_cancel_sort(job);
+    }, &startedJob, &job));
+    startedJob = job;
+
+    char ** sortedPlugins;
+    size_t numPlugins;
+    EXPECT_EQ(loot_error_cancelled, loot_wait_for_sort(job, &sortedPlugins, &numPlugins));
+    EXPECT_EQ(NULL, sortedPlugins);
+    EXPECT_EQ(0, numPlugins);
+
+    const char * error;
+    EXPECT_EQ(loot_ok, loot_get_error_message(&error));
+    EXPECT_STREQ("The operation was cancelled.", error);
+
+    loot_destroy_sort_job(job);
+
+    // The database should still be usable.
+    EXPECT_EQ(loot_ok, loot_sort_plugins(db, &sortedPlugins, &numPlugins));
+    EXPECT_EQ(11, numPlugins);
+}
+
 TEST_F(SkyrimAPIOperationsTest, SortPlugins) {
     char ** sortedPlugins;
     size_t numPlugins;
@@ -497,6 +616,28 @@ TEST_F(OblivionAPIOperationsTest, GetTagMap) {
     EXPECT_STREQ("Stats", tagMap[21]);
 }
 
+TEST_F(OblivionAPIOperationsTest, GetTagMap_ShouldNotChangeWhenTheListsAreEvaluated) {
+    char ** tagMap;
+    size_t numTags;
+    ASSERT_NO_THROW(GenerateMasterlist());
+    ASSERT_EQ(loot_ok, loot_load_lists(db, masterlistPath.string().c_str(), NULL));
+    ASSERT_EQ(loot_ok, loot_get_tag_map(db, &tagMap, &numTags));
+    std::vector<std::string> loadedTags(tagMap, tagMap + numTags);
+
+    ASSERT_EQ(loot_ok, loot_eval_lists(db, loot_lang_english));
+    ASSERT_EQ(loot_ok, loot_get_tag_map(db, &tagMap, &numTags));
+    EXPECT_EQ(loadedTags, std::vector<std::string>(tagMap, tagMap + numTags));
+
+    // The map is still valid for plugin tag queries after evaluation.
+    unsigned int * added;
+    unsigned int * removed;
+    size_t numAdded, numRemoved;
+    bool modified;
+    EXPECT_EQ(loot_ok, loot_get_plugin_tags(db, "Unofficial Oblivion Patch.esp", &added, &numAdded, &removed, &numRemoved, &modified));
+    ASSERT_EQ(1, numRemoved);
+    EXPECT_EQ("C.Water", loadedTags[removed[0]]);
+}
+
 TEST_F(OblivionAPIOperationsTest, GetPluginTags) {
     unsigned int * added;
     unsigned int * removed;
@@ -628,6 +769,146 @@ TEST_F(OblivionAPIOperationsTest, GetDirtyInfo) {
     EXPECT_EQ(loot_needs_cleaning_no, needsCleaning);
 }
 
+TEST_F(OblivionAPIOperationsTest, GetPluginsInfo) {
+    const char * plugins[] = {
+        "Unofficial Oblivion Patch.esp",
+        "Blank.esp",
+        "nVidia Black Screen Fix.esp",
+        "Hammerfell.esm",
+    };
+    loot_plugin_info * info;
+    EXPECT_EQ(loot_error_invalid_args, loot_get_plugins_info(NULL, plugins, 4, &info));
+    EXPECT_EQ(loot_error_invalid_args, loot_get_plugins_info(db, NULL, 4, &info));
+    EXPECT_EQ(loot_error_invalid_args, loot_get_plugins_info(db, plugins, 4, NULL));
+
+    // Get info before getting a tag map.
+    EXPECT_EQ(loot_error_no_tag_map, loot_get_plugins_info(db, plugins, 4, &info));
+
+    char ** tagMap;
+    size_t numTags;
+    ASSERT_NO_THROW(GenerateMasterlist());
+    ASSERT_EQ(loot_ok, loot_load_lists(db, masterlistPath.string().c_str(), NULL));
+    ASSERT_EQ(loot_ok, loot_get_tag_map(db, &tagMap, &numTags));
+
+    EXPECT_EQ(loot_ok, loot_get_plugins_info(db, plugins, 0, &info));
+    EXPECT_EQ(NULL, info);
+
+    ASSERT_EQ(loot_ok, loot_get_plugins_info(db, plugins, 4, &info));
+    ASSERT_NE(nullptr, info);
+
+    // The output should match that of the single plugin functions.
+    for (size_t i = 0; i < 4; ++i) {
+        unsigned int * added;
+        unsigned int * removed;
+        size_t numAdded, numRemoved;
+        bool modified;
+        ASSERT_EQ(loot_ok, loot_get_plugin_tags(db, plugins[i], &added, &numAdded, &removed, &numRemoved, &modified));
+        ASSERT_EQ(numAdded, info[i].numTags_added);
+        for (size_t j = 0; j < numAdded; ++j)
+            EXPECT_EQ(added[j], info[i].tagIds_added[j]);
+        ASSERT_EQ(numRemoved, info[i].numTags_removed);
+        for (size_t j = 0; j < numRemoved; ++j)
+            EXPECT_EQ(removed[j], info[i].tagIds_removed[j]);
+        EXPECT_EQ(modified, info[i].userlistModified);
+
+        loot_message * messages;
+        size_t numMessages;
+        ASSERT_EQ(loot_ok, loot_get_plugin_messages(db, plugins[i], &messages, &numMessages));
+        ASSERT_EQ(numMessages, info[i].numMessages);
+        for (size_t j = 0; j < numMessages; ++j) {
+            EXPECT_EQ(messages[j].type, info[i].messages[j].type);
+            EXPECT_STREQ(messages[j].message, info[i].messages[j].message);
+        }
+
+        unsigned int needsCleaning;
+        ASSERT_EQ(loot_ok, loot_get_dirty_info(db, plugins[i], &needsCleaning));
+        EXPECT_EQ(needsCleaning, info[i].needsCleaning);
+    }
+
+    EXPECT_EQ(21, info[0].numTags_added);
+    EXPECT_EQ(loot_needs_cleaning_no, info[0].needsCleaning);
+    EXPECT_EQ(0, info[1].numTags_added);
+    EXPECT_EQ(NULL, info[1].tagIds_added);
+    EXPECT_EQ(NULL, info[1].messages);
+    EXPECT_EQ(2, info[2].numMessages);
+    EXPECT_STREQ("Alternatively, remove this and use UOP v3.0.1+ instead.", info[2].messages[1].message);
+    EXPECT_EQ(loot_needs_cleaning_yes, info[3].needsCleaning);
+}
+
+TEST_F(OblivionAPIOperationsTest, ReleaseThreadOutputs) {
+    EXPECT_EQ(loot_error_invalid_args, loot_release_thread_outputs(NULL));
+
+    // Releasing outputs that were never made is fine.
+    EXPECT_EQ(loot_ok, loot_release_thread_outputs(db));
+
+    char ** tagMap;
+    size_t numTags;
+    ASSERT_NO_THROW(GenerateMasterlist());
+    ASSERT_EQ(loot_ok, loot_load_lists(db, masterlistPath.string().c_str(), NULL));
+    ASSERT_EQ(loot_ok, loot_get_tag_map(db, &tagMap, &numTags));
+
+    loot_message * messages;
+    size_t numMessages;
+    ASSERT_EQ(loot_ok, loot_get_plugin_messages(db, "nVidia Black Screen Fix.esp", &messages, &numMessages));
+    EXPECT_EQ(2, numMessages);
+    EXPECT_EQ(loot_ok, loot_release_thread_outputs(db));
+
+    // The thread can still query the database afterwards.
+    ASSERT_EQ(loot_ok, loot_get_plugin_messages(db, "nVidia Black Screen Fix.esp", &messages, &numMessages));
+    ASSERT_EQ(2, numMessages);
+    EXPECT_STREQ("Alternatively, remove this and use UOP v3.0.1+ instead.", messages[1].message);
+}
+
+TEST_F(OblivionAPIOperationsTest, QueriesShouldRunWhileTheListsAreEvaluated) {
+    char ** tagMap;
+    size_t numTags;
+    ASSERT_NO_THROW(GenerateMasterlist());
+    ASSERT_EQ(loot_ok, loot_load_lists(db, masterlistPath.string().c_str(), NULL));
+    ASSERT_EQ(loot_ok, loot_eval_lists(db, loot_lang_english));
+    ASSERT_EQ(loot_ok, loot_get_tag_map(db, &tagMap, &numTags));
+
+    loot_message * messages;
+    size_t numMessages;
+    ASSERT_EQ(loot_ok, loot_get_plugin_messages(db, "nVidia Black Screen Fix.esp", &messages, &numMessages));
+    std::vector<std::string> expectedMessages;
+    for (size_t i = 0; i < numMessages; ++i)
+        expectedMessages.push_back(messages[i].message);
+    ASSERT_EQ(2, expectedMessages.size());
+
+    // Each thread's outputs are its own, so they should stay valid while
+    // other threads query the same handle.
+    std::atomic<bool> failed(false);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.push_back(std::thread([&]() {
+            for (int j = 0; j < 20; ++j) {
+                loot_message * threadMessages;
+                size_t numThreadMessages;
+                unsigned int needsCleaning;
+                if (loot_get_plugin_messages(db, "nVidia Black Screen Fix.esp", &threadMessages, &numThreadMessages) != loot_ok
+                    || loot_get_dirty_info(db, "Hammerfell.esm", &needsCleaning) != loot_ok
+                    || numThreadMessages != expectedMessages.size()
+                    || needsCleaning != loot_needs_cleaning_yes) {
+                    failed = true;
+                    return;
+                }
+                for (size_t k = 0; k < numThreadMessages; ++k) {
+                    if (expectedMessages[k] != threadMessages[k].message)
+                        failed = true;
+                }
+            }
+        }));
+    }
+
+    for (int i = 0; i < 5; ++i)
+        EXPECT_EQ(loot_ok, loot_eval_lists(db, loot_lang_english));
+
+    for (auto& thread : threads)
+        thread.join();
+
+    EXPECT_FALSE(failed);
+}
+
 TEST_F(OblivionAPIOperationsTest, WriteMinimalList) {
     std::string outputFile = (localPath / "minimal.yml").string();
     EXPECT_EQ(loot_error_invalid_args, loot_write_minimal_list(NULL, outputFile.c_str(), false));
@@ -643,6 +924,28 @@ TEST_F(OblivionAPIOperationsTest, WriteMinimalList) {
     ASSERT_NO_THROW(boost::filesystem::remove(outputFile));
     EXPECT_EQ(loot_ok, loot_write_minimal_list(db, outputFile.c_str(), true));
     EXPECT_TRUE(boost::filesystem::exists(outputFile));
+    EXPECT_FALSE(boost::filesystem::exists(outputFile + ".tmp"));
+
+    // A failed write should leave the existing file in place.
+    const uintmax_t fileSize = boost::filesystem::file_size(outputFile);
+    ASSERT_NO_THROW(boost::filesystem::create_directory(outputFile + ".tmp"));
+    EXPECT_NE(loot_ok, loot_write_minimal_list(db, outputFile.c_str(), true));
+    ASSERT_NO_THROW(boost::filesystem::remove(outputFile + ".tmp"));
+    EXPECT_EQ(fileSize, boost::filesystem::file_size(outputFile));
+    ASSERT_NO_THROW(boost::filesystem::remove(outputFile));
+
+    // Only entries with Bash Tags or dirty info are written, in name order.
+    ASSERT_NO_THROW(GenerateMasterlist());
+    ASSERT_EQ(loot_ok, loot_load_lists(db, masterlistPath.string().c_str(), NULL));
+    EXPECT_EQ(loot_ok, loot_write_minimal_list(db, outputFile.c_str(), false));
+
+    YAML::Node minimalList = YAML::LoadFile(outputFile);
+    ASSERT_EQ(2, minimalList["plugins"].size());
+    EXPECT_EQ("Hammerfell.esm", minimalList["plugins"][0]["name"].as<std::string>());
+    EXPECT_TRUE(minimalList["plugins"][0]["dirty"]);
+    EXPECT_EQ("Unofficial Oblivion Patch.esp", minimalList["plugins"][1]["name"].as<std::string>());
+    EXPECT_EQ(22, minimalList["plugins"][1]["tag"].size());
+    EXPECT_FALSE(minimalList["plugins"][1]["msg"]);
     ASSERT_NO_THROW(boost::filesystem::remove(outputFile));
 
     // Check that Bash Tag removals get outputted correctly.
@@ -0,0 +1,113 @@
+/*  LOOT
+
+    A load order optimisation tool for Oblivion, Skyrim, Fallout 3 and
+    Fallout: New Vegas.
+
+    Copyright (C) 2012-2015    WrinklyNinja
+
+    This file is part of LOOT.
+
+    LOOT is free software: you can redistribute
+    it and/or modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    LOOT is distributed in the hope that it will
+    be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with LOOT.  If not, see
+    <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef LOOT_TEST_BACKEND_GAME_DATA_DIRECTORY_SNAPSHOT
+#define LOOT_TEST_BACKEND_GAME_DATA_DIRECTORY_SNAPSHOT
+
+#include "backend/game/data_directory_snapshot.h"
+
+#include "tests/fixtures.h"
+
+class DataDirectorySnapshot : public SkyrimTest {};
+
+TEST_F(DataDirectorySnapshot, Refresh) {
+    loot::DataDirectorySnapshot snapshot;
+    EXPECT_FALSE(snapshot.Covers(dataPath));
+
+    EXPECT_NO_THROW(snapshot.Refresh(dataPath));
+    EXPECT_TRUE(snapshot.Covers(dataPath));
+    EXPECT_FALSE(snapshot.Covers(missingPath));
+    EXPECT_EQ(snapshot.Entries().size(), snapshot.Filenames().size());
+    EXPECT_NE(snapshot.Filenames().end(), std::find(snapshot.Filenames().begin(), snapshot.Filenames().end(), "Blank.esm"));
+
+    EXPECT_THROW(snapshot.Refresh(missingPath), boost::filesystem::filesystem_error);
+    EXPECT_FALSE(snapshot.Covers(dataPath));
+}
+
+TEST_F(DataDirectorySnapshot, Clear) {
+    loot::DataDirectorySnapshot snapshot;
+    snapshot.Refresh(dataPath);
+
+    EXPECT_NO_THROW(snapshot.Clear());
+    EXPECT_FALSE(snapshot.Covers(dataPath));
+    EXPECT_TRUE(snapshot.Entries().empty());
+    EXPECT_TRUE(snapshot.Filenames().empty());
+}
+
+TEST_F(DataDirectorySnapshot, Exists) {
+    loot::DataDirectorySnapshot snapshot;
+    EXPECT_EQ(std::make_pair(false, false), snapshot.Exists(dataPath, "Blank.esm"));
+
+    snapshot.Refresh(dataPath);
+    EXPECT_EQ(std::make_pair(true, true), snapshot.Exists(dataPath, "Blank.esm"));
+    EXPECT_EQ(std::make_pair(true, true), snapshot.Exists(dataPath, "blank.ESM"));
+    EXPECT_EQ(std::make_pair(false, true), snapshot.Exists(dataPath, "Blank.missing.esm"));
+    EXPECT_EQ(std::make_pair(false, true), snapshot.Exists(dataPath, "Blank - Master Dependent.esm"));
+    EXPECT_EQ(std::make_pair(true, true), snapshot.Exists(dataPath, "Blank - Master Dependent.esm.ghost"));
+
+    // Paths outside the snapshot can't be answered.
+    EXPECT_EQ(std::make_pair(false, false), snapshot.Exists(missingPath, "Blank.esm"));
+    EXPECT_EQ(std::make_pair(false, false), snapshot.Exists(dataPath, "resource/detail/resource.txt"));
+    EXPECT_EQ(std::make_pair(false, false), snapshot.Exists(dataPath, ".."));
+}
+
+TEST_F(DataDirectorySnapshot, Find) {
+    loot::DataDirectorySnapshot snapshot;
+    EXPECT_FALSE(snapshot.Find(dataPath, "Blank.esm").second);
+
+    snapshot.Refresh(dataPath);
+    auto found = snapshot.Find(dataPath, "blank.ESM");
+    ASSERT_TRUE(found.second);
+    ASSERT_NE(loot::DataDirectorySnapshot::npos, found.first);
+    EXPECT_EQ("Blank.esm", snapshot.Filenames()[found.first]);
+    EXPECT_EQ(loot::StampPath(dataPath / "Blank.esm"), snapshot.Stamp(found.first));
+
+    EXPECT_EQ(std::make_pair(loot::DataDirectorySnapshot::npos, true), snapshot.Find(dataPath, "Blank.missing.esm"));
+    EXPECT_FALSE(snapshot.Find(dataPath, "resource/detail/resource.txt").second);
+}
+
+TEST_F(DataDirectorySnapshot, Stamp_ShouldKeepAnEntrysFirstStampUntilTheNextRefresh) {
+    loot::DataDirectorySnapshot snapshot;
+    snapshot.Refresh(dataPath);
+    const size_t i = snapshot.Find(dataPath, "Blank.esm").first;
+    ASSERT_NE(loot::DataDirectorySnapshot::npos, i);
+
+    const std::time_t modificationTime = boost::filesystem::last_write_time(dataPath / "Blank.esm");
+    const loot::PathStamp stamp = snapshot.Stamp(i);
+    EXPECT_EQ(modificationTime, stamp.modificationTime);
+    EXPECT_EQ(boost::filesystem::file_size(dataPath / "Blank.esm"), stamp.size);
+
+    boost::filesystem::last_write_time(dataPath / "Blank.esm", modificationTime + 60);
+    EXPECT_EQ(stamp, snapshot.Stamp(i));
+
+    // Copies keep the stamps already taken.
+    loot::DataDirectorySnapshot copy(snapshot);
+    EXPECT_EQ(stamp, copy.Stamp(i));
+
+    snapshot.Refresh(dataPath);
+    EXPECT_EQ(modificationTime + 60, snapshot.Stamp(snapshot.Find(dataPath, "Blank.esm").first).modificationTime);
+    boost::filesystem::last_write_time(dataPath / "Blank.esm", modificationTime);
+}
+
+#endif
@@ -480,6 +480,56 @@ TEST_F(Game, LoadPlugins) {
     EXPECT_EQ(1, plugin.NumOverrideFormIDs());
 }
 
+TEST_F(Game, LoadPlugins_ShouldThrowIfCancelled) {
+    loot::Game game(loot::Game::tes5);
+    game.SetGamePath(dataPath.parent_path());
+
+    loot::CancellationToken cancellation;
+    cancellation.Cancel();
+    EXPECT_THROW(game.LoadPlugins(false, cancellation), loot::error);
+    EXPECT_FALSE(game.ArePluginsFullyLoaded());
+}
+
+TEST_F(Game, LoadPlugins_ShouldOnlyReloadChangedPlugins) {
+    loot::Game game(loot::Game::tes5);
+    game.SetGamePath(dataPath.parent_path());
+
+    ASSERT_NO_THROW(game.LoadPlugins(false));
+    ASSERT_NE(0, game.plugins.find("blank.esm")->second.Crc());
+    ASSERT_NE(0, game.plugins.find("blank.esp")->second.Crc());
+
+    // Unchanged plugins should keep their full data when only headers are
+    // requested.
+    std::time_t modificationTime = boost::filesystem::last_write_time(dataPath / "Blank.esp");
+    boost::filesystem::last_write_time(dataPath / "Blank.esp", modificationTime + 60);
+    EXPECT_NO_THROW(game.LoadPlugins(true));
+    boost::filesystem::last_write_time(dataPath / "Blank.esp", modificationTime);
+
+    EXPECT_EQ(11, game.plugins.size());
+    EXPECT_NE(0, game.plugins.find("blank.esm")->second.Crc());
+    EXPECT_EQ(0, game.plugins.find("blank.esp")->second.Crc());
+    EXPECT_FALSE(game.ArePluginsFullyLoaded());
+
+    game.ClearLoadedPluginStamps();
+    EXPECT_NO_THROW(game.LoadPlugins(true));
+    EXPECT_EQ(0, game.plugins.find("blank.esm")->second.Crc());
+}
+
+TEST_F(Game, LoadPlugins_ShouldRemovePluginsThatAreNoLongerInstalled) {
+    loot::Game game(loot::Game::tes5);
+    game.SetGamePath(dataPath.parent_path());
+
+    ASSERT_NO_THROW(game.LoadPlugins(true));
+    ASSERT_EQ(11, game.plugins.size());
+
+    ASSERT_NO_THROW(boost::filesystem::rename(dataPath / "Blank.esp", dataPath / "Blank.esp.bak"));
+    EXPECT_NO_THROW(game.LoadPlugins(true));
+    ASSERT_NO_THROW(boost::filesystem::rename(dataPath / "Blank.esp.bak", dataPath / "Blank.esp"));
+
+    EXPECT_EQ(10, game.plugins.size());
+    EXPECT_EQ(game.plugins.end(), game.plugins.find("blank.esp"));
+}
+
 TEST_F(Game, LoadPlugins_HeadersOnly) {
     loot::Game game(loot::Game::tes5);
     game.SetGamePath(dataPath.parent_path());
@@ -631,6 +681,136 @@ TEST_F(Game, ArePluginsFullyLoaded) {
     EXPECT_TRUE(game.ArePluginsFullyLoaded());
 }
 
+TEST_F(Game, ArePluginsFullyLoaded_ShouldFollowTheLoadModeForAnEmptyDataFolder) {
+    ASSERT_NO_THROW(boost::filesystem::create_directories(missingPath / "Data"));
+    loot::Game game(loot::Game::tes5);
+    game.SetGamePath(missingPath);
+
+    EXPECT_NO_THROW(game.LoadPlugins(true));
+    EXPECT_TRUE(game.plugins.empty());
+    EXPECT_FALSE(game.ArePluginsFullyLoaded());
+
+    EXPECT_NO_THROW(game.LoadPlugins(false));
+    EXPECT_TRUE(game.ArePluginsFullyLoaded());
+
+    EXPECT_NO_THROW(game.LoadPlugins(true));
+    EXPECT_FALSE(game.ArePluginsFullyLoaded());
+
+    ASSERT_NO_THROW(boost::filesystem::remove_all(missingPath));
+}
+
+TEST_F(Game, EvalConditionProbes) {
+    loot::Game game(loot::Game::tes5);
+    game.SetGamePath(dataPath.parent_path());
+
+    std::set<std::string> probes({
+        "file(\"Blank.esm\")",
+        "file(\"Blank.missing.esm\")",
+        "regex(\"Blank\\.es(m|p)\")",
+        "checksum(\"Blank.esm\", 0)",
+        "file(\"../../..\")",
+    });
+    EXPECT_NO_THROW(game.EvalConditionProbes(probes));
+
+    EXPECT_EQ(std::make_pair(true, true), game.GetCachedFileExists("Blank.esm"));
+    EXPECT_EQ(std::make_pair(false, true), game.GetCachedFileExists("Blank.missing.esm"));
+    EXPECT_EQ(std::make_pair((size_t)2, true), game.GetCachedRegexMatches("Blank\\.es(m|p)"));
+    EXPECT_NE(0, game.GetCachedCrc("Blank.esm"));
+}
+
+TEST_F(Game, DataFileExists) {
+    loot::Game game(loot::Game::tes5);
+    game.SetGamePath(dataPath.parent_path());
+
+    // Check both with and without a snapshot.
+    for (int i = 0; i < 2; ++i) {
+        EXPECT_TRUE(game.DataFileExists("Blank.esm"));
+        EXPECT_TRUE(game.DataFileExists("Blank - Master Dependent.esm"));
+        EXPECT_TRUE(game.DataFileExists("resource/detail/resource.txt"));
+        EXPECT_FALSE(game.DataFileExists("Blank.missing.esm"));
+        EXPECT_FALSE(game.DataFileExists("resource/detail/resource.missing.txt"));
+
+        game.RefreshDataSnapshot();
+    }
+    EXPECT_TRUE(game.DataSnapshot().Covers(game.DataPath()));
+}
+
+TEST_F(Game, DataFilePath) {
+    loot::Game game(loot::Game::tes5);
+    game.SetGamePath(dataPath.parent_path());
+
+    // Check both with and without a snapshot.
+    for (int i = 0; i < 2; ++i) {
+        EXPECT_EQ(game.DataPath() / "Blank.esm", game.DataFilePath("Blank.esm"));
+        EXPECT_EQ(game.DataPath() / "Blank - Master Dependent.esm.ghost", game.DataFilePath("Blank - Master Dependent.esm"));
+        EXPECT_EQ(game.DataPath() / "Blank.missing.esm", game.DataFilePath("Blank.missing.esm"));
+        EXPECT_EQ(game.DataPath() / "resource.txt", game.DataFilePath("resource.txt"));
+
+        game.RefreshDataSnapshot();
+    }
+
+    // Files in the snapshot are given with their names' case on disk.
+    EXPECT_EQ(game.DataPath() / "Blank.esm", game.DataFilePath("blank.ESM"));
+    EXPECT_EQ(game.DataPath() / "Blank - Master Dependent.esm.ghost", game.DataFilePath("blank - master dependent.esm"));
+}
+
+TEST_F(Game, GetPathStamp) {
+    loot::Game game(loot::Game::tes5);
+    game.SetGamePath(dataPath.parent_path());
+
+    EXPECT_EQ(loot::PathStamp(), game.GetPathStamp("Blank.missing.esp"));
+    EXPECT_EQ(loot::PathStamp(boost::filesystem::last_write_time(dataPath / "Blank.esm"), boost::filesystem::file_size(dataPath / "Blank.esm")), game.GetPathStamp("Blank.esm"));
+
+    // Ghosted plugins should be stamped using their ghosted file.
+    boost::filesystem::path ghostPath = dataPath / "Blank - Master Dependent.esm.ghost";
+    EXPECT_EQ(loot::PathStamp(boost::filesystem::last_write_time(ghostPath), boost::filesystem::file_size(ghostPath)), game.GetPathStamp("Blank - Master Dependent.esm"));
+}
+
+TEST_F(Game, GetPathStamp_ShouldUseTheSnapshotForFilesInIt) {
+    loot::Game game(loot::Game::tes5);
+    game.SetGamePath(dataPath.parent_path());
+    game.RefreshDataSnapshot();
+
+    loot::PathStamp stamp(game.GetPathStamp("Blank.esm"));
+    EXPECT_EQ(stamp, game.GetPathStamp("blank.ESM"));
+    EXPECT_EQ(loot::PathStamp(), game.GetPathStamp("Blank.missing.esp"));
+
+    // Changes aren't seen until the snapshot is refreshed.
+    std::time_t modificationTime = boost::filesystem::last_write_time(dataPath / "Blank.esm");
+    boost::filesystem::last_write_time(dataPath / "Blank.esm", modificationTime + 60);
+    EXPECT_EQ(stamp, game.GetPathStamp("Blank.esm"));
+
+    game.RefreshDataSnapshot();
+    EXPECT_EQ(modificationTime + 60, game.GetPathStamp("Blank.esm").modificationTime);
+
+    boost::filesystem::last_write_time(dataPath / "Blank.esm", modificationTime);
+}
+
+TEST_F(Game, InvalidateChangedPaths) {
+    loot::Game game(loot::Game::tes5);
+    game.SetGamePath(dataPath.parent_path());
+
+    loot::CacheDependencies dependencies;
+    dependencies.paths.insert("Blank.esm");
+    game.TrackPath("Blank.esm");
+    game.CacheCondition("file(\"Blank.esm\")", true, dependencies);
+    game.CacheCrc("Blank.esm", 5);
+
+    // Nothing has changed, so nothing should be invalidated.
+    EXPECT_NO_THROW(game.InvalidateChangedPaths());
+    EXPECT_EQ(std::make_pair(true, true), game.GetCachedCondition("file(\"Blank.esm\")"));
+    EXPECT_EQ(5, game.GetCachedCrc("Blank.esm"));
+
+    std::time_t modificationTime = boost::filesystem::last_write_time(dataPath / "Blank.esm");
+    boost::filesystem::last_write_time(dataPath / "Blank.esm", modificationTime + 60);
+
+    EXPECT_NO_THROW(game.InvalidateChangedPaths());
+    EXPECT_EQ(std::make_pair(false, false), game.GetCachedCondition("file(\"Blank.esm\")"));
+    EXPECT_EQ(0, game.GetCachedCrc("Blank.esm"));
+
+    boost::filesystem::last_write_time(dataPath / "Blank.esm", modificationTime);
+}
+
 TEST(ToGames, EmptySettings) {
     EXPECT_EQ(std::list<loot::Game>(), loot::ToGames(std::list<loot::GameSettings>()));
 }
@@ -22,8 +22,8 @@ along with LOOT.  If not, see
 <http://www.gnu.org/licenses/>.
 */
 
-#ifndef LOOT_TEST_BACKEND_GAME
-#define LOOT_TEST_BACKEND_GAME
+#ifndef LOOT_TEST_BACKEND_GAME_GAME_CACHE
+#define LOOT_TEST_BACKEND_GAME_GAME_CACHE
 
 #include "backend/game/game_cache.h"
 
@@ -91,6 +91,158 @@ TEST_F(GameCache, CacheActivePlugins) {
     EXPECT_FALSE(cache.IsPluginActive("Blank.missing.esp"));
 }
 
-TEST_F(GameCache, ClearCache) {}
+TEST_F(GameCache, CacheFileExists) {
+    loot::GameCache cache;
+    EXPECT_NO_THROW(cache.CacheFileExists("Blank.esp", true));
+    EXPECT_NO_THROW(cache.CacheFileExists("Blank.missing.esp", false));
+
+    EXPECT_EQ(std::make_pair(true, true), cache.GetCachedFileExists("blank.Esp"));
+    EXPECT_EQ(std::make_pair(false, true), cache.GetCachedFileExists("blank.Missing.esp"));
+    EXPECT_EQ(std::make_pair(false, false), cache.GetCachedFileExists("Blank.esm"));
+}
+
+TEST_F(GameCache, CacheRegexMatches) {
+    loot::GameCache cache;
+    EXPECT_NO_THROW(cache.CacheRegexMatches("Blank.*\\.esp", "", 2));
+
+    EXPECT_EQ(std::make_pair((size_t)2, true), cache.GetCachedRegexMatches("Blank.*\\.esp"));
+    EXPECT_EQ(std::make_pair((size_t)0, false), cache.GetCachedRegexMatches("blank.*\\.ESP"));
+    EXPECT_EQ(std::make_pair((size_t)0, false), cache.GetCachedRegexMatches("Blank.*\\.esm"));
+}
+
+TEST_F(GameCache, CacheRegexMatches_ShouldKeepRegexesThatOnlyDifferInCaseApart) {
+    loot::GameCache cache;
+    cache.CacheRegexMatches("\\S+\\.esp", "", 3);
+    cache.CacheRegexMatches("\\s+\\.esp", "", 0);
+    cache.CacheRegexMatches("Blank\\W\\.esp", "", 1);
+    cache.CacheRegexMatches("Blank\\w\\.esp", "", 4);
+
+    EXPECT_EQ(std::make_pair((size_t)3, true), cache.GetCachedRegexMatches("\\S+\\.esp"));
+    EXPECT_EQ(std::make_pair((size_t)0, true), cache.GetCachedRegexMatches("\\s+\\.esp"));
+    EXPECT_EQ(std::make_pair((size_t)1, true), cache.GetCachedRegexMatches("Blank\\W\\.esp"));
+    EXPECT_EQ(std::make_pair((size_t)4, true), cache.GetCachedRegexMatches("Blank\\w\\.esp"));
+
+    // Invalidating the directory discards both.
+    cache.InvalidatePath("Blank.esp");
+    EXPECT_FALSE(cache.GetCachedRegexMatches("\\S+\\.esp").second);
+    EXPECT_FALSE(cache.GetCachedRegexMatches("\\s+\\.esp").second);
+}
+
+TEST_F(GameCache, CacheVersion) {
+    loot::GameCache cache;
+    EXPECT_NO_THROW(cache.CacheVersion("Blank.esp", "5.0"));
+
+    EXPECT_EQ(std::make_pair(std::string("5.0"), true), cache.GetCachedVersion("blank.Esp"));
+    EXPECT_EQ(std::make_pair(std::string(""), false), cache.GetCachedVersion("Blank.esm"));
+}
+
+TEST_F(GameCache, CacheDirectoryListing) {
+    loot::GameCache cache;
+    auto listing = std::make_shared<const std::vector<std::string>>(std::vector<std::string>({"Blank.esp"}));
+    EXPECT_NO_THROW(cache.CacheDirectoryListing("Data\\Textures", listing));
+
+    EXPECT_EQ(std::make_pair(listing, true), cache.GetCachedDirectoryListing("data/textures"));
+    EXPECT_FALSE(cache.GetCachedDirectoryListing("Data").second);
+
+    // Invalidating a file also invalidates its directory's listing.
+    cache.InvalidatePath("Data/Textures/Blank.dds");
+    EXPECT_FALSE(cache.GetCachedDirectoryListing("Data/Textures").second);
+}
+
+TEST_F(GameCache, CachePathStamp) {
+    loot::GameCache cache;
+    EXPECT_NO_THROW(cache.CachePathStamp("Blank.esp", loot::PathStamp(10, 5)));
+    // Existing stamps are not replaced.
+    EXPECT_NO_THROW(cache.CachePathStamp("blank.esp", loot::PathStamp(20, 5)));
+
+    EXPECT_EQ(std::make_pair(loot::PathStamp(10, 5), true), cache.GetCachedPathStamp("Blank.ESP"));
+    EXPECT_EQ(std::make_pair(loot::PathStamp(), false), cache.GetCachedPathStamp("Blank.esm"));
+
+    std::unordered_map<std::string, loot::PathStamp> expected({
+        {"Blank.esp", loot::PathStamp(10, 5)},
+    });
+    EXPECT_EQ(expected, cache.GetCachedPathStamps());
+}
+
+TEST_F(GameCache, InvalidatePath) {
+    loot::GameCache cache;
+    loot::CacheDependencies fileDependencies;
+    fileDependencies.paths.insert("Data/Blank.esp");
+    loot::CacheDependencies directoryDependencies;
+    directoryDependencies.paths.insert("Data");
+    loot::CacheDependencies otherDependencies;
+    otherDependencies.paths.insert("Blank.esm");
+
+    cache.CacheCondition("file(\"Data/Blank.esp\")", true, fileDependencies);
+    cache.CacheCondition("regex(\"Data/Blank.*\")", true, directoryDependencies);
+    cache.CacheCondition("file(\"Blank.esm\")", true, otherDependencies);
+    cache.CacheFileExists("Data/Blank.esp", true);
+    cache.CacheRegexMatches("Data/Blank.*", "Data", 1);
+    cache.CachePathStamp("Data/Blank.esp", loot::PathStamp(10, 5));
+
+    // Separators and ghost extensions are ignored.
+    EXPECT_NO_THROW(cache.InvalidatePath("data\\blank.esp.ghost"));
+
+    EXPECT_EQ(std::make_pair(false, false), cache.GetCachedCondition("file(\"Data/Blank.esp\")"));
+    EXPECT_EQ(std::make_pair(false, false), cache.GetCachedCondition("regex(\"Data/Blank.*\")"));
+    EXPECT_EQ(std::make_pair(true, true), cache.GetCachedCondition("file(\"Blank.esm\")"));
+    EXPECT_EQ(std::make_pair(false, false), cache.GetCachedFileExists("Data/Blank.esp"));
+    EXPECT_EQ(std::make_pair((size_t)0, false), cache.GetCachedRegexMatches("Data/Blank.*"));
+    EXPECT_FALSE(cache.GetCachedPathStamp("Data/Blank.esp").second);
+}
+
+TEST_F(GameCache, InvalidateActivePlugin) {
+    loot::GameCache cache;
+    loot::CacheDependencies dependencies;
+    dependencies.activePlugins.insert("Blank.esp");
+
+    cache.CacheCondition("active(\"Blank.esp\")", true, dependencies);
+    cache.CacheCondition("file(\"Blank.esp\")", true);
+
+    EXPECT_NO_THROW(cache.InvalidateActivePlugin("blank.esp"));
+
+    EXPECT_EQ(std::make_pair(false, false), cache.GetCachedCondition("active(\"Blank.esp\")"));
+    EXPECT_EQ(std::make_pair(true, true), cache.GetCachedCondition("file(\"Blank.esp\")"));
+}
+
+TEST_F(GameCache, CacheActivePlugins_InvalidatesChangedPlugins) {
+    loot::GameCache cache;
+    loot::CacheDependencies blankDependencies;
+    blankDependencies.activePlugins.insert("Blank.esp");
+    loot::CacheDependencies skyrimDependencies;
+    skyrimDependencies.activePlugins.insert("Skyrim.esm");
+
+    cache.CacheActivePlugins(std::unordered_set<std::string>({"skyrim.esm"}));
+    cache.CacheCondition("active(\"Blank.esp\")", false, blankDependencies);
+    cache.CacheCondition("active(\"Skyrim.esm\")", true, skyrimDependencies);
+
+    cache.CacheActivePlugins(std::unordered_set<std::string>({"skyrim.esm", "blank.esp"}));
+
+    EXPECT_EQ(std::make_pair(false, false), cache.GetCachedCondition("active(\"Blank.esp\")"));
+    EXPECT_EQ(std::make_pair(true, true), cache.GetCachedCondition("active(\"Skyrim.esm\")"));
+}
+
+TEST_F(GameCache, ClearCache) {
+    loot::GameCache cache;
+    std::unordered_set<std::string> plugins({"skyrim.esm"});
+
+    cache.CacheCrc("Blank.esp", 5);
+    cache.CacheCondition("True Condition", true);
+    cache.CacheActivePlugins(plugins);
+    cache.CacheFileExists("Blank.esp", true);
+    cache.CacheRegexMatches("Blank.*\\.esp", "", 2);
+    cache.CacheVersion("Blank.esp", "5.0");
+    cache.CachePathStamp("Blank.esp", loot::PathStamp(10, 5));
+
+    EXPECT_NO_THROW(cache.ClearCache());
+
+    EXPECT_EQ(0, cache.GetCachedCrc("Blank.esp"));
+    EXPECT_EQ(std::make_pair(false, false), cache.GetCachedCondition("True Condition"));
+    EXPECT_FALSE(cache.IsPluginActive("Skyrim.esm"));
+    EXPECT_EQ(std::make_pair(false, false), cache.GetCachedFileExists("Blank.esp"));
+    EXPECT_EQ(std::make_pair((size_t)0, false), cache.GetCachedRegexMatches("Blank.*\\.esp"));
+    EXPECT_EQ(std::make_pair(std::string(""), false), cache.GetCachedVersion("Blank.esp"));
+    EXPECT_FALSE(cache.GetCachedPathStamp("Blank.esp").second);
+}
 
 #endif
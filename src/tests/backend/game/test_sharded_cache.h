@@ -0,0 +1,118 @@
+/*  LOOT
+
+    A load order optimisation tool for Oblivion, Skyrim, Fallout 3 and
+    Fallout: New Vegas.
+
+    Copyright (C) 2012-2015    WrinklyNinja
+
+    This file is part of LOOT.
+
+    LOOT is free software: you can redistribute
+    it and/or modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    LOOT is distributed in the hope that it will
+    be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with LOOT.  If not, see
+    <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef LOOT_TEST_BACKEND_GAME_SHARDED_CACHE
+#define LOOT_TEST_BACKEND_GAME_SHARDED_CACHE
+
+#include "backend/game/sharded_cache.h"
+
+#include <map>
+
+#include <gtest/gtest.h>
+
+TEST(CacheKey, Folded) {
+    EXPECT_EQ("blank.esp", loot::CacheKey("Blank.ESP", false).Folded());
+    EXPECT_EQ("data\\blank.esp", loot::CacheKey("Data\\Blank.esp", false).Folded());
+    EXPECT_EQ("data/blank.esp", loot::CacheKey("Data\\Blank.esp/", true).Folded());
+    EXPECT_EQ("", loot::CacheKey("/", true).Folded());
+    EXPECT_EQ("\\S+\\.esp", loot::CacheKey("\\S+\\.esp", false, true).Folded());
+    EXPECT_EQ("Data/Ä.esp", loot::CacheKey("Data\\Ä.esp/", true, true).Folded());
+}
+
+TEST(CacheKey, HashAndEquals) {
+    loot::CacheKey key("Data\\Blank.ESP", true);
+
+    EXPECT_EQ(loot::CacheKey("data/blank.esp", true).Hash(), key.Hash());
+    EXPECT_TRUE(key.Equals("data/blank.esp"));
+    EXPECT_FALSE(key.Equals("data/blank.esm"));
+    EXPECT_FALSE(key.Equals("data/blank.esp.ghost"));
+}
+
+TEST(ShardedCache, InsertAndFind) {
+    loot::ShardedCache<int> cache(false);
+    cache.Insert("Blank.esp", 1);
+    // Existing values are not replaced.
+    cache.Insert("blank.ESP", 2);
+
+    EXPECT_EQ(std::make_pair(1, true), cache.Find("BLANK.esp"));
+    EXPECT_EQ(std::make_pair(0, false), cache.Find("Blank.esm"));
+}
+
+TEST(ShardedCache, CaseSensitiveKeys) {
+    loot::ShardedCache<int> cache(false, true);
+    cache.Insert("\\S+\\.esp", 1);
+    cache.Insert("\\s+\\.esp", 2);
+
+    EXPECT_EQ(std::make_pair(1, true), cache.Find("\\S+\\.esp"));
+    EXPECT_EQ(std::make_pair(2, true), cache.Find("\\s+\\.esp"));
+    EXPECT_EQ(std::make_pair(0, false), cache.Find("\\S+\\.ESP"));
+
+    cache.Erase("\\s+\\.esp");
+    EXPECT_EQ(std::make_pair(1, true), cache.Find("\\S+\\.esp"));
+    EXPECT_EQ(std::make_pair(0, false), cache.Find("\\s+\\.esp"));
+}
+
+TEST(ShardedCache, Erase) {
+    loot::ShardedCache<int> cache(true);
+    cache.Insert("Data/Blank.esp", 1);
+    cache.Insert("Data/Blank.esm", 2);
+
+    cache.Erase("data\\blank.esp");
+
+    EXPECT_EQ(std::make_pair(0, false), cache.Find("Data/Blank.esp"));
+    EXPECT_EQ(std::make_pair(2, true), cache.Find("Data/Blank.esm"));
+}
+
+TEST(ShardedCache, ClearAndForEach) {
+    loot::ShardedCache<int> cache(false);
+    cache.Insert("Blank.esp", 1);
+    cache.Insert("Blank.esm", 2);
+
+    std::map<std::string, int> entries;
+    cache.ForEach([&](const std::string& key, int value) {
+        entries.insert(std::make_pair(key, value));
+    });
+    std::map<std::string, int> expected({
+        {"blank.esp", 1},
+        {"blank.esm", 2},
+    });
+    EXPECT_EQ(expected, entries);
+
+    cache.Clear();
+    entries.clear();
+    cache.ForEach([&](const std::string& key, int value) {
+        entries.insert(std::make_pair(key, value));
+    });
+    EXPECT_TRUE(entries.empty());
+}
+
+TEST(ShardedCache, CopyConstructor) {
+    loot::ShardedCache<int> cache(false);
+    cache.Insert("Blank.esp", 1);
+
+    loot::ShardedCache<int> cache2(cache);
+    EXPECT_EQ(std::make_pair(1, true), cache2.Find("blank.esp"));
+}
+
+#endif
@@ -26,10 +26,81 @@ along with LOOT.  If not, see
 #define LOOT_TEST_BACKEND_HELPERS_VERSION
 
 #include "backend/globals.h"
+#include "backend/helpers/streams.h"
 #include "backend/helpers/version.h"
 #include "tests/fixtures.h"
 
-class Version : public SkyrimTest {};
+#include <cstring>
+#include <vector>
+
+class Version : public SkyrimTest {
+protected:
+    // Writes a minimal PE file with a single .rsrc section holding an
+    // RT_VERSION resource.
+    static void WritePEFile(const boost::filesystem::path& file, uint32_t versionMS, uint32_t versionLS) {
+        std::vector<char> data(0x300, 0);
+        auto put16 = [&](size_t offset, uint32_t value) {
+            data[offset] = value & 0xFF;
+            data[offset + 1] = (value >> 8) & 0xFF;
+        };
+        auto put32 = [&](size_t offset, uint32_t value) {
+            put16(offset, value & 0xFFFF);
+            put16(offset + 2, value >> 16);
+        };
+
+        // DOS header, PE signature, COFF header and PE32 optional header.
+        data[0] = 'M';
+        data[1] = 'Z';
+        put32(0x3C, 0x40);
+        data[0x40] = 'P';
+        data[0x41] = 'E';
+        put16(0x44, 0x14C);
+        put16(0x46, 1);
+        put16(0x54, 224);
+        put16(0x58, 0x10B);
+        put32(0x58 + 92, 16);
+        put32(0x58 + 96 + 16, 0x1000);
+        put32(0x58 + 96 + 20, 0xB0);
+
+        // Section header.
+        const size_t section = 0x58 + 224;
+        std::memcpy(&data[section], ".rsrc", 5);
+        put32(section + 8, 0x100);
+        put32(section + 12, 0x1000);
+        put32(section + 16, 0x100);
+        put32(section + 20, 0x200);
+
+        // Resource directories for type, name and language.
+        const size_t rsrc = 0x200;
+        put16(rsrc + 14, 1);
+        put32(rsrc + 16, 16);
+        put32(rsrc + 20, 0x80000018);
+        put16(rsrc + 0x18 + 14, 1);
+        put32(rsrc + 0x18 + 16, 1);
+        put32(rsrc + 0x18 + 20, 0x80000030);
+        put16(rsrc + 0x30 + 14, 1);
+        put32(rsrc + 0x30 + 16, 0x409);
+        put32(rsrc + 0x30 + 20, 0x48);
+
+        // Data entry and VS_VERSIONINFO with its VS_FIXEDFILEINFO.
+        put32(rsrc + 0x48, 0x1058);
+        put32(rsrc + 0x48 + 4, 92);
+        const size_t info = rsrc + 0x58;
+        put16(info, 92);
+        put16(info + 2, 52);
+        const std::string key("VS_VERSION_INFO");
+        for (size_t i = 0; i < key.size(); ++i)
+            put16(info + 6 + 2 * i, key[i]);
+        put32(info + 40, 0xFEEF04BD);
+        put32(info + 44, 0x10000);
+        put32(info + 48, versionMS);
+        put32(info + 52, versionLS);
+
+        loot::ofstream out(file);
+        out.write(data.data(), data.size());
+        out.close();
+    }
+};
 
 TEST_F(Version, ConstructorsAndDataAccess) {
     loot::Version version;
@@ -50,6 +121,27 @@ TEST_F(Version, ConstructorsAndDataAccess) {
 #endif
 }
 
+TEST_F(Version, FileConstructorShouldReturnEmptyStringForFilesWithoutVersionResource) {
+    EXPECT_EQ("", loot::Version(dataPath / "Blank.esm").AsString());
+    EXPECT_EQ("", loot::Version(dataPath / "missing.dll").AsString());
+}
+
+#ifndef _WIN32
+TEST_F(Version, FileConstructorShouldReadVersionResourceAndRereadChangedFiles) {
+    boost::filesystem::path file(dataPath / "version.dll");
+    WritePEFile(file, (1 << 16) | 2, (3 << 16) | 4);
+    EXPECT_EQ("1.2.3.4", loot::Version(file).AsString());
+    EXPECT_EQ("1.2.3.4", loot::Version(file).AsString());
+
+    std::time_t modificationTime = boost::filesystem::last_write_time(file);
+    WritePEFile(file, 5 << 16, 6);
+    boost::filesystem::last_write_time(file, modificationTime + 10);
+    EXPECT_EQ("5.0.0.6", loot::Version(file).AsString());
+
+    boost::filesystem::remove(file);
+}
+#endif
+
 TEST_F(Version, GreaterThan) {
     loot::Version version1, version2;
     EXPECT_FALSE(version1 > version2);
@@ -130,6 +222,21 @@ TEST_F(Version, Equal) {
     EXPECT_FALSE(version2 == version1);
 }
 
+TEST_F(Version, ComparisonsShouldFollowPseudosemRules) {
+    EXPECT_EQ(loot::Version(std::string("1.0")), loot::Version(std::string("1.0.0")));
+    EXPECT_EQ(loot::Version(std::string("v1.0")), loot::Version(std::string("1.0")));
+    EXPECT_EQ(loot::Version(std::string("1.0+build.5")), loot::Version(std::string("1.0")));
+    EXPECT_EQ(loot::Version(std::string("1.0-Beta")), loot::Version(std::string("1.0-beta")));
+    EXPECT_EQ(loot::Version(std::string("1_0:2")), loot::Version(std::string("1.0.2")));
+
+    EXPECT_LT(loot::Version(std::string("1.9")), loot::Version(std::string("1.10")));
+    EXPECT_LT(loot::Version(std::string("1.0.0-beta")), loot::Version(std::string("1.0.0")));
+    EXPECT_LT(loot::Version(std::string("1.0.0-alpha")), loot::Version(std::string("1.0.0-alpha.1")));
+    EXPECT_LT(loot::Version(std::string("1.0.0-alpha.2")), loot::Version(std::string("1.0.0-alpha.beta")));
+    EXPECT_LT(loot::Version(std::string("1.0")), loot::Version(std::string("1.0 beta")));
+    EXPECT_GT(loot::Version(std::string("2")), loot::Version(std::string("1.99.99")));
+}
+
 TEST_F(Version, NotEqual) {
     loot::Version version1, version2;
     EXPECT_FALSE(version1 != version2);
@@ -274,6 +274,29 @@ TEST_F(ConditionGrammar, VersionConditionEqualTrue) {
     EXPECT_TRUE(eval);
 }
 
+TEST_F(ConditionGrammar, VersionConditionUsesLoadedPluginVersion) {
+    loot::Game game(loot::Game::tes5);
+    game.SetGamePath(dataPath.parent_path());
+    ASSERT_NO_THROW(game.Init(false, localPath));
+
+    // The loaded plugin has no version, so parsing the file would give a
+    // different result.
+    game.plugins.insert(std::make_pair("blank.esm", loot::Plugin("Blank.esm")));
+
+    boost::spirit::qi::space_type skipper;
+    bool eval = true;
+    bool r = false;
+    Grammar cg(&game);
+
+    std::string condition("version(\"Blank.esm\", \"5.0\", ==)");
+    std::string::const_iterator begin = condition.begin();
+    std::string::const_iterator end = condition.end();
+
+    EXPECT_NO_THROW(r = boost::spirit::qi::phrase_parse(begin, end, cg, skipper, eval));
+    EXPECT_TRUE(r);
+    EXPECT_FALSE(eval);
+}
+
 TEST_F(ConditionGrammar, VersionConditionEqualFalse) {
     loot::Game game(loot::Game::tes5);
     game.SetGamePath(dataPath.parent_path());
@@ -83,4 +83,29 @@ TEST_F(ConditionalMetadata, ParseCondition) {
     EXPECT_NO_THROW(cm.ParseCondition());
 }
 
+TEST_F(ConditionalMetadata, CollectProbes) {
+    std::set<std::string> probes;
+    loot::ConditionalMetadata cm;
+    cm.CollectProbes(probes);
+    EXPECT_TRUE(probes.empty());
+
+    // Invalid conditions are skipped.
+    cm = loot::ConditionalMetadata("condition");
+    EXPECT_NO_THROW(cm.CollectProbes(probes));
+    EXPECT_TRUE(probes.empty());
+
+    cm = loot::ConditionalMetadata("file(\"Blank.esm\") and not many(\"Blank.*\") or active(\"Blank.esp\")");
+    cm.CollectProbes(probes);
+    cm = loot::ConditionalMetadata("regex(\"Blank.*\") or checksum(\"Blank.esp\", 3d7f89ad) or version(\"Blank.esm\", \"5.0\", >)");
+    cm.CollectProbes(probes);
+
+    std::set<std::string> expected({
+        "file(\"Blank.esm\")",
+        "regex(\"Blank.*\")",
+        "checksum(\"Blank.esp\", 0)",
+        "version(\"Blank.esm\", \"0\", ==)",
+    });
+    EXPECT_EQ(expected, probes);
+}
+
 #endif
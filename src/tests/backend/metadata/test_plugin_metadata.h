@@ -134,32 +134,32 @@ TEST_F(PluginMetadata, MergeMetadata) {
     EXPECT_TRUE(pm1.Enabled());
     EXPECT_EQ(5, pm1.Priority());
     EXPECT_TRUE(pm1.IsPriorityExplicit());
-    EXPECT_EQ(std::set<loot::File>({
+    EXPECT_EQ(boost::container::flat_set<loot::File>({
         loot::File("Blank.esm"),
         loot::File("Blank.esp"),
     }), pm1.LoadAfter());
-    EXPECT_EQ(std::set<loot::File>({
+    EXPECT_EQ(boost::container::flat_set<loot::File>({
         loot::File("Blank.esm"),
         loot::File("Blank.esp"),
     }), pm1.Reqs());
-    EXPECT_EQ(std::set<loot::File>({
+    EXPECT_EQ(boost::container::flat_set<loot::File>({
         loot::File("Blank.esm"),
         loot::File("Blank.esp"),
     }), pm1.Incs());
-    EXPECT_EQ(std::list<loot::Message>({
+    EXPECT_EQ(std::vector<loot::Message>({
         loot::Message(loot::Message::say, "content"),
         loot::Message(loot::Message::say, "content"),
     }), pm1.Messages());
-    EXPECT_EQ(std::set<loot::Tag>({
+    EXPECT_EQ(boost::container::flat_set<loot::Tag>({
         loot::Tag("Relev"),
         loot::Tag("Relev", false),
         loot::Tag("Delev"),
     }), pm1.Tags());
-    EXPECT_EQ(std::set<loot::PluginDirtyInfo>({
+    EXPECT_EQ(boost::container::flat_set<loot::PluginDirtyInfo>({
         loot::PluginDirtyInfo(5, 0, 1, 2, "utility"),
         loot::PluginDirtyInfo(9, 0, 1, 2, "utility"),
     }), pm1.DirtyInfo());
-    EXPECT_EQ(std::set<loot::Location>({
+    EXPECT_EQ(boost::container::flat_set<loot::Location>({
         loot::Location("http://www.example.com"),
         loot::Location("http://www.example2.com"),
     }), pm1.Locations());
@@ -244,32 +244,32 @@ TEST_F(PluginMetadata, DiffMetadata) {
     EXPECT_FALSE(result.Enabled());
     EXPECT_EQ(0, result.Priority());
     EXPECT_FALSE(result.IsPriorityExplicit());
-    EXPECT_EQ(std::set<loot::File>({
+    EXPECT_EQ(boost::container::flat_set<loot::File>({
         loot::File("Blank.esp"),
         loot::File("Blank - Different.esm"),
     }), result.LoadAfter());
-    EXPECT_EQ(std::set<loot::File>({
+    EXPECT_EQ(boost::container::flat_set<loot::File>({
         loot::File("Blank.esp"),
         loot::File("Blank - Different.esm"),
     }), result.Reqs());
-    EXPECT_EQ(std::set<loot::File>({
+    EXPECT_EQ(boost::container::flat_set<loot::File>({
         loot::File("Blank.esp"),
         loot::File("Blank - Different.esm"),
     }), result.Incs());
-    EXPECT_EQ(std::list<loot::Message>({
+    EXPECT_EQ(std::vector<loot::Message>({
         loot::Message(loot::Message::say, "content2"),
         loot::Message(loot::Message::say, "content3"),
     }), result.Messages());
-    EXPECT_EQ(std::set<loot::Tag>({
+    EXPECT_EQ(boost::container::flat_set<loot::Tag>({
         loot::Tag("Relev", false),
         loot::Tag("Delev"),
         loot::Tag("NoMerge"),
     }), result.Tags());
-    EXPECT_EQ(std::set<loot::PluginDirtyInfo>({
+    EXPECT_EQ(boost::container::flat_set<loot::PluginDirtyInfo>({
         loot::PluginDirtyInfo(9, 0, 1, 2, "utility"),
         loot::PluginDirtyInfo(1, 0, 1, 2, "utility"),
     }), result.DirtyInfo());
-    EXPECT_EQ(std::set<loot::Location>({
+    EXPECT_EQ(boost::container::flat_set<loot::Location>({
         loot::Location("http://www.example2.com"),
         loot::Location("http://www.other-example.com"),
     }), result.Locations());
@@ -355,26 +355,26 @@ TEST_F(PluginMetadata, NewMetadata) {
     EXPECT_TRUE(result.Enabled());
     EXPECT_EQ(0, result.Priority());
     EXPECT_FALSE(result.IsPriorityExplicit());
-    EXPECT_EQ(std::set<loot::File>({
+    EXPECT_EQ(boost::container::flat_set<loot::File>({
         loot::File("Blank.esp")
     }), result.LoadAfter());
-    EXPECT_EQ(std::set<loot::File>({
+    EXPECT_EQ(boost::container::flat_set<loot::File>({
         loot::File("Blank.esp")
     }), result.Reqs());
-    EXPECT_EQ(std::set<loot::File>({
+    EXPECT_EQ(boost::container::flat_set<loot::File>({
         loot::File("Blank.esp")
     }), result.Incs());
-    EXPECT_EQ(std::list<loot::Message>({
+    EXPECT_EQ(std::vector<loot::Message>({
         loot::Message(loot::Message::say, "content3"),
     }), result.Messages());
-    EXPECT_EQ(std::set<loot::Tag>({
+    EXPECT_EQ(boost::container::flat_set<loot::Tag>({
         loot::Tag("Relev", false),
         loot::Tag("Delev"),
     }), result.Tags());
-    EXPECT_EQ(std::set<loot::PluginDirtyInfo>({
+    EXPECT_EQ(boost::container::flat_set<loot::PluginDirtyInfo>({
         loot::PluginDirtyInfo(9, 0, 1, 2, "utility")
     }), result.DirtyInfo());
-    EXPECT_EQ(std::set<loot::Location>({
+    EXPECT_EQ(boost::container::flat_set<loot::Location>({
         loot::Location("http://www.example2.com")
     }), result.Locations());
 
@@ -412,7 +412,7 @@ TEST_F(PluginMetadata, LoadAfter) {
     pm.LoadAfter({
         loot::File("Blank.esm")
     });
-    EXPECT_EQ(std::set<loot::File>({
+    EXPECT_EQ(boost::container::flat_set<loot::File>({
         loot::File("Blank.esm")
     }), pm.LoadAfter());
 }
@@ -423,7 +423,7 @@ TEST_F(PluginMetadata, Reqs) {
     pm.Reqs({
         loot::File("Blank.esm")
     });
-    EXPECT_EQ(std::set<loot::File>({
+    EXPECT_EQ(boost::container::flat_set<loot::File>({
         loot::File("Blank.esm")
     }), pm.Reqs());
 }
@@ -434,7 +434,7 @@ TEST_F(PluginMetadata, Incs) {
     pm.Incs({
         loot::File("Blank.esm")
     });
-    EXPECT_EQ(std::set<loot::File>({
+    EXPECT_EQ(boost::container::flat_set<loot::File>({
         loot::File("Blank.esm")
     }), pm.Incs());
 }
@@ -445,7 +445,7 @@ TEST_F(PluginMetadata, Messages) {
     pm.Messages({
         loot::Message(loot::Message::say, "content")
     });
-    EXPECT_EQ(std::list<loot::Message>({
+    EXPECT_EQ(std::vector<loot::Message>({
         loot::Message(loot::Message::say, "content")
     }), pm.Messages());
 }
@@ -456,7 +456,7 @@ TEST_F(PluginMetadata, Tags) {
     pm.Tags({
         loot::Tag("Relev")
     });
-    EXPECT_EQ(std::set<loot::Tag>({
+    EXPECT_EQ(boost::container::flat_set<loot::Tag>({
         loot::Tag("Relev")
     }), pm.Tags());
 }
@@ -467,7 +467,7 @@ TEST_F(PluginMetadata, DirtyInfo) {
     pm.DirtyInfo({
         loot::PluginDirtyInfo(5, 0, 1, 2, "utility")
     });
-    EXPECT_EQ(std::set<loot::PluginDirtyInfo>({
+    EXPECT_EQ(boost::container::flat_set<loot::PluginDirtyInfo>({
         loot::PluginDirtyInfo(5, 0, 1, 2, "utility")
     }), pm.DirtyInfo());
 }
@@ -478,7 +478,7 @@ TEST_F(PluginMetadata, Locations) {
     pm.Locations({
         loot::Location("http://www.example.com")
     });
-    EXPECT_EQ(std::set<loot::Location>({
+    EXPECT_EQ(boost::container::flat_set<loot::Location>({
         loot::Location("http://www.example.com")
     }), pm.Locations());
 }
@@ -518,18 +518,18 @@ TEST_F(PluginMetadata, EvalAllConditions) {
 
     pm.Messages({loot::Message(loot::Message::say, "content")});
     EXPECT_NO_THROW(pm.EvalAllConditions(game, loot::Language::english));
-    EXPECT_EQ(std::set<loot::File>({
+    EXPECT_EQ(boost::container::flat_set<loot::File>({
         loot::File("Blank.esm", "", "file(\"Blank.esm\")")
     }), pm.LoadAfter());
     EXPECT_TRUE(pm.Reqs().empty());
-    EXPECT_EQ(std::set<loot::File>({
+    EXPECT_EQ(boost::container::flat_set<loot::File>({
         loot::File("Blank.esm", "", "file(\"Blank.esm\")")
     }), pm.Incs());
-    EXPECT_EQ(std::list<loot::Message>({
+    EXPECT_EQ(std::vector<loot::Message>({
         loot::Message(loot::Message::say, "content")
     }), pm.Messages());
     EXPECT_TRUE(pm.Tags().empty());
-    EXPECT_EQ(std::set<loot::PluginDirtyInfo>({
+    EXPECT_EQ(boost::container::flat_set<loot::PluginDirtyInfo>({
         loot::PluginDirtyInfo(0x24F0E2A1, 0, 1, 2, "utility")
     }), pm.DirtyInfo());
 }
@@ -762,31 +762,31 @@ TEST_F(PluginMetadata, YamlEncode) {
 
     pm.LoadAfter({loot::File("Blank.esm")});
     node = pm;
-    EXPECT_EQ(pm.LoadAfter(), node["after"].as<std::set<loot::File>>());
+    EXPECT_EQ(pm.LoadAfter(), node["after"].as<boost::container::flat_set<loot::File>>());
 
     pm.Reqs({loot::File("Blank.esm")});
     node = pm;
-    EXPECT_EQ(pm.Reqs(), node["req"].as<std::set<loot::File>>());
+    EXPECT_EQ(pm.Reqs(), node["req"].as<boost::container::flat_set<loot::File>>());
 
     pm.Incs({loot::File("Blank.esm")});
     node = pm;
-    EXPECT_EQ(pm.Incs(), node["inc"].as<std::set<loot::File>>());
+    EXPECT_EQ(pm.Incs(), node["inc"].as<boost::container::flat_set<loot::File>>());
 
     pm.Messages({loot::Message(loot::Message::say, "content")});
     node = pm;
-    EXPECT_EQ(pm.Messages(), node["msg"].as<std::list<loot::Message>>());
+    EXPECT_EQ(pm.Messages(), node["msg"].as<std::vector<loot::Message>>());
 
     pm.Tags({loot::Tag("Relev")});
     node = pm;
-    EXPECT_EQ(pm.Tags(), node["tag"].as<std::set<loot::Tag>>());
+    EXPECT_EQ(pm.Tags(), node["tag"].as<boost::container::flat_set<loot::Tag>>());
 
     pm.DirtyInfo({loot::PluginDirtyInfo(5, 0, 1, 2, "utility")});
     node = pm;
-    EXPECT_EQ(pm.DirtyInfo(), node["dirty"].as<std::set<loot::PluginDirtyInfo>>());
+    EXPECT_EQ(pm.DirtyInfo(), node["dirty"].as<boost::container::flat_set<loot::PluginDirtyInfo>>());
 
     pm.Locations({loot::Location("http://www.example.com")});
     node = pm;
-    EXPECT_EQ(pm.Locations(), node["url"].as<std::set<loot::Location>>());
+    EXPECT_EQ(pm.Locations(), node["url"].as<boost::container::flat_set<loot::Location>>());
 }
 
 TEST_F(PluginMetadata, YamlDecode) {
@@ -825,25 +825,25 @@ TEST_F(PluginMetadata, YamlDecode) {
     EXPECT_EQ(5, pm.Priority());
     EXPECT_TRUE(pm.IsPriorityExplicit());
     EXPECT_FALSE(pm.Enabled());
-    EXPECT_EQ(std::set<loot::File>({
+    EXPECT_EQ(boost::container::flat_set<loot::File>({
         loot::File("Blank.esm")
     }), pm.LoadAfter());
-    EXPECT_EQ(std::set<loot::File>({
+    EXPECT_EQ(boost::container::flat_set<loot::File>({
         loot::File("Blank.esm")
     }), pm.Reqs());
-    EXPECT_EQ(std::set<loot::File>({
+    EXPECT_EQ(boost::container::flat_set<loot::File>({
         loot::File("Blank.esm")
     }), pm.Incs());
-    EXPECT_EQ(std::list<loot::Message>({
+    EXPECT_EQ(std::vector<loot::Message>({
         loot::Message(loot::Message::say, "content")
     }), pm.Messages());
-    EXPECT_EQ(std::set<loot::Tag>({
+    EXPECT_EQ(boost::container::flat_set<loot::Tag>({
         loot::Tag("Relev")
     }), pm.Tags());
-    EXPECT_EQ(std::set<loot::PluginDirtyInfo>({
+    EXPECT_EQ(boost::container::flat_set<loot::PluginDirtyInfo>({
         loot::PluginDirtyInfo(5, 0, 1, 2, "utility")
     }), pm.DirtyInfo());
-    EXPECT_EQ(std::set<loot::Location>({
+    EXPECT_EQ(boost::container::flat_set<loot::Location>({
         loot::Location("http://www.example.com")
     }), pm.Locations());
 
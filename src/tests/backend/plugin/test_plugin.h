@@ -297,7 +297,7 @@ TEST_F(Plugin, CheckInstallValidity) {
         loot::PluginDirtyInfo(0xDEADBEEF, 0, 5, 10, "utility2"),
     });
     EXPECT_TRUE(plugin.CheckInstallValidity(game));
-    EXPECT_EQ(std::list<loot::Message>({
+    EXPECT_EQ(std::vector<loot::Message>({
         loot::Message(loot::Message::error, "This plugin requires \"Blank.missing.esm\" to be installed, but it is missing."),
         loot::Message(loot::Message::error, "This plugin is incompatible with \"Skyrim.esm\", but both are present."),
         loot::PluginDirtyInfo(0x187BE342, 0, 1, 2, "utility1").AsMessage(),
@@ -306,7 +306,7 @@ TEST_F(Plugin, CheckInstallValidity) {
 
     plugin = loot::Plugin(game, "Blank - Different Master Dependent.esp", false);
     EXPECT_FALSE(plugin.CheckInstallValidity(game));
-    EXPECT_EQ(std::list<loot::Message>({
+    EXPECT_EQ(std::vector<loot::Message>({
         loot::Message(loot::Message::error, "This plugin requires \"Blank - Different.esm\" to be active, but it is inactive."),
     }), plugin.Messages());
 
@@ -28,7 +28,14 @@ along with LOOT.  If not, see
 #include "backend/masterlist.h"
 #include "tests/fixtures.h"
 
-class Masterlist : public SkyrimTest {};
+class Masterlist : public SkyrimTest {
+protected:
+    inline virtual void TearDown() {
+        ASSERT_NO_THROW(boost::filesystem::remove(loot::Masterlist::CachePath(masterlistPath, localPath)));
+
+        SkyrimTest::TearDown();
+    }
+};
 
 TEST_F(Masterlist, Update_Game) {
     loot::Game game(loot::Game::tes5);
@@ -99,6 +106,86 @@ TEST_F(Masterlist, Update_NonGame) {
         "master"));
 }
 
+TEST_F(Masterlist, Load_ShouldWriteAndReuseBinaryCache) {
+    ASSERT_NO_THROW(boost::filesystem::copy("./testing-metadata/masterlist.yaml", masterlistPath));
+
+    loot::MetadataList expected;
+    ASSERT_NO_THROW(expected.Load(masterlistPath));
+
+    loot::Masterlist masterlist;
+    ASSERT_NO_THROW(masterlist.Load(masterlistPath, localPath));
+    EXPECT_TRUE(boost::filesystem::exists(loot::Masterlist::CachePath(masterlistPath, localPath)));
+
+    // This load reads the cache written above.
+    loot::Masterlist cached;
+    ASSERT_NO_THROW(cached.Load(masterlistPath, localPath));
+    EXPECT_EQ(expected.messages, cached.messages);
+    EXPECT_EQ(expected.Plugins().size(), cached.Plugins().size());
+    for (const auto& plugin : expected.Plugins()) {
+        loot::PluginMetadata expectedPlugin = expected.FindPlugin(plugin);
+        loot::PluginMetadata cachedPlugin = cached.FindPlugin(plugin);
+
+        EXPECT_EQ(expectedPlugin.Enabled(), cachedPlugin.Enabled());
+        EXPECT_EQ(expectedPlugin.Priority(), cachedPlugin.Priority());
+        EXPECT_EQ(expectedPlugin.IsPriorityExplicit(), cachedPlugin.IsPriorityExplicit());
+        EXPECT_EQ(expectedPlugin.LoadAfter(), cachedPlugin.LoadAfter());
+        EXPECT_EQ(expectedPlugin.Reqs(), cachedPlugin.Reqs());
+        EXPECT_EQ(expectedPlugin.Incs(), cachedPlugin.Incs());
+        EXPECT_EQ(expectedPlugin.Messages(), cachedPlugin.Messages());
+        EXPECT_EQ(expectedPlugin.Tags(), cachedPlugin.Tags());
+        EXPECT_EQ(expectedPlugin.DirtyInfo(), cachedPlugin.DirtyInfo());
+        EXPECT_EQ(expectedPlugin.Locations(), cachedPlugin.Locations());
+    }
+}
+
+TEST_F(Masterlist, Load_ShouldIgnoreCacheForDifferentMasterlistContent) {
+    ASSERT_NO_THROW(boost::filesystem::copy("./testing-metadata/masterlist.yaml", masterlistPath));
+
+    loot::Masterlist masterlist;
+    ASSERT_NO_THROW(masterlist.Load(masterlistPath, localPath));
+    ASSERT_TRUE(boost::filesystem::exists(loot::Masterlist::CachePath(masterlistPath, localPath)));
+
+    loot::ofstream out(masterlistPath);
+    out << "plugins:\n  - name: Blank.esm\n    priority: 5\n";
+    out.close();
+
+    ASSERT_NO_THROW(masterlist.Load(masterlistPath, localPath));
+    EXPECT_EQ(1, masterlist.Plugins().size());
+    EXPECT_EQ(5, masterlist.FindPlugin(loot::PluginMetadata("Blank.esm")).Priority());
+    EXPECT_TRUE(masterlist.messages.empty());
+}
+
+TEST_F(Masterlist, Load_ShouldNotWriteACacheIfNoCacheFolderIsGiven) {
+    ASSERT_NO_THROW(boost::filesystem::copy("./testing-metadata/masterlist.yaml", masterlistPath));
+
+    loot::Masterlist masterlist;
+    ASSERT_NO_THROW(masterlist.Load(masterlistPath));
+    EXPECT_FALSE(masterlist.Plugins().empty());
+    EXPECT_FALSE(boost::filesystem::exists(loot::Masterlist::CachePath(masterlistPath, localPath)));
+
+    std::shared_ptr<const loot::Masterlist> shared;
+    ASSERT_NO_THROW(shared = loot::Masterlist::LoadShared(masterlistPath));
+    EXPECT_FALSE(boost::filesystem::exists(loot::Masterlist::CachePath(masterlistPath, localPath)));
+}
+
+TEST_F(Masterlist, LoadShared_ShouldShareListsLoadedFromTheSameContent) {
+    ASSERT_NO_THROW(boost::filesystem::copy("./testing-metadata/masterlist.yaml", masterlistPath));
+
+    std::shared_ptr<const loot::Masterlist> first, second;
+    ASSERT_NO_THROW(first = loot::Masterlist::LoadShared(masterlistPath));
+    ASSERT_NO_THROW(second = loot::Masterlist::LoadShared(masterlistPath));
+    EXPECT_EQ(first, second);
+
+    loot::ofstream out(masterlistPath);
+    out << "plugins:\n  - name: Blank.esm\n    priority: 5\n";
+    out.close();
+
+    ASSERT_NO_THROW(second = loot::Masterlist::LoadShared(masterlistPath));
+    EXPECT_NE(first, second);
+    EXPECT_EQ(1, second->Plugins().size());
+    EXPECT_EQ(5, second->FindPlugin(loot::PluginMetadata("Blank.esm")).Priority());
+}
+
 TEST_F(Masterlist, GetInfo_NoMasterlist) {
     loot::Masterlist masterlist;
     EXPECT_ANY_THROW(masterlist.GetInfo(masterlistPath, false));
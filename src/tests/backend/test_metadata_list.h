@@ -25,6 +25,8 @@ along with LOOT.  If not, see
 #ifndef LOOT_TEST_BACKEND_METADATA_LIST
 #define LOOT_TEST_BACKEND_METADATA_LIST
 
+#include "backend/error.h"
+#include "backend/helpers/streams.h"
 #include "backend/metadata_list.h"
 #include "tests/fixtures.h"
 
@@ -103,6 +105,108 @@ TEST_F(MetadataList, Load) {
     EXPECT_TRUE(ml.Plugins().empty());
 }
 
+TEST_F(MetadataList, Load_ShouldResolveAliasesBetweenPluginEntries) {
+    loot::ofstream out(savedMetadataPath);
+    out << "common:\n"
+        << "  - &warning\n"
+        << "    type: warn\n"
+        << "    content: 'A warning.'\n"
+        << "globals:\n"
+        << "  - *warning\n"
+        << "plugins:\n"
+        << "  - name: Blank.esm\n"
+        << "    after: &after [ 'Blank.esp' ]\n"
+        << "  - name: Blank - Different.esm\n"
+        << "    req: *after\n"
+        << "    msg: [ *warning ]\n";
+    out.close();
+
+    loot::MetadataList ml;
+    ASSERT_NO_THROW(ml.Load(savedMetadataPath));
+
+    std::list<loot::Message> expectedMessages({
+        loot::Message(loot::Message::warn, "A warning."),
+    });
+    EXPECT_EQ(expectedMessages, ml.messages);
+    EXPECT_EQ(2, ml.Plugins().size());
+
+    loot::PluginMetadata pm = ml.FindPlugin(loot::PluginMetadata("Blank.esm"));
+    EXPECT_EQ(boost::container::flat_set<loot::File>({
+        loot::File("Blank.esp"),
+    }), pm.LoadAfter());
+
+    pm = ml.FindPlugin(loot::PluginMetadata("Blank - Different.esm"));
+    EXPECT_EQ(boost::container::flat_set<loot::File>({
+        loot::File("Blank.esp"),
+    }), pm.Reqs());
+    EXPECT_EQ(std::vector<loot::Message>(expectedMessages.begin(), expectedMessages.end()), pm.Messages());
+}
+
+TEST_F(MetadataList, Load_ShouldDecodeManyEntriesInDocumentOrder) {
+    loot::ofstream out(savedMetadataPath);
+    out << "plugins:\n";
+    for (int i = 0; i < 300; ++i) {
+        out << "  - name: Plugin" << i << ".esp\n"
+            << "    priority: " << i << "\n";
+    }
+    out << "  - name: 'Plugin.*\\.esp'\n"
+        << "    tag: [ Relev ]\n";
+    out.close();
+
+    loot::MetadataList ml;
+    ASSERT_NO_THROW(ml.Load(savedMetadataPath));
+    EXPECT_EQ(301, ml.Plugins().size());
+
+    loot::PluginMetadata pm = ml.FindPlugin(loot::PluginMetadata("Plugin250.esp"));
+    EXPECT_EQ(250, pm.Priority());
+    EXPECT_EQ(boost::container::flat_set<loot::Tag>({
+        loot::Tag("Relev"),
+    }), pm.Tags());
+}
+
+TEST_F(MetadataList, Load_ShouldDecodeAliasedNodesSharedByManyEntries) {
+    loot::ofstream out(savedMetadataPath);
+    out << "plugins:\n"
+        << "  - name: Plugin0.esp\n"
+        << "    msg: &msg\n"
+        << "      - type: say\n"
+        << "        content: 'A shared message.'\n"
+        << "    tag: &tags [ Relev, Delev ]\n";
+    for (int i = 1; i < 300; ++i) {
+        out << "  - name: Plugin" << i << ".esp\n"
+            << "    msg: *msg\n"
+            << "    tag: *tags\n";
+    }
+    out.close();
+
+    loot::MetadataList ml;
+    ASSERT_NO_THROW(ml.Load(savedMetadataPath));
+    EXPECT_EQ(300, ml.Plugins().size());
+
+    for (int i = 0; i < 300; ++i) {
+        loot::PluginMetadata pm = ml.FindPlugin(loot::PluginMetadata("Plugin" + std::to_string(i) + ".esp"));
+        ASSERT_EQ(1, pm.Messages().size());
+        EXPECT_EQ("A shared message.", pm.Messages()[0].ChooseContent(loot::Language::any).Str());
+        EXPECT_EQ(boost::container::flat_set<loot::Tag>({
+            loot::Tag("Relev"),
+            loot::Tag("Delev"),
+        }), pm.Tags());
+    }
+}
+
+TEST_F(MetadataList, Load_ShouldReportDuplicateEntriesAmongManyEntries) {
+    loot::ofstream out(savedMetadataPath);
+    out << "plugins:\n";
+    for (int i = 0; i < 300; ++i) {
+        out << "  - name: Plugin" << i << ".esp\n";
+    }
+    out << "  - name: Plugin10.esp\n";
+    out.close();
+
+    loot::MetadataList ml;
+    EXPECT_THROW(ml.Load(savedMetadataPath), loot::error);
+}
+
 TEST_F(MetadataList, Load_Invalid) {
     loot::MetadataList ml;
     for (const auto& path : invalidMetadataPaths) {
@@ -160,14 +264,96 @@ TEST_F(MetadataList, FindPlugin) {
 
     pm = ml.FindPlugin(loot::PluginMetadata("Blank - Different.esp"));
     EXPECT_EQ("Blank - Different.esp", pm.Name());
-    EXPECT_EQ(std::set<loot::File>({
+    EXPECT_EQ(boost::container::flat_set<loot::File>({
         loot::File("Blank.esm"),
     }), pm.LoadAfter());
-    EXPECT_EQ(std::set<loot::File>({
+    EXPECT_EQ(boost::container::flat_set<loot::File>({
         loot::File("Blank.esp"),
     }), pm.Incs());
 }
 
+TEST_F(MetadataList, FindPlugin_ShouldMergeEveryMatchingRegexEntry) {
+    loot::MetadataList ml;
+
+    loot::PluginMetadata pm(".+Dependent\\.esp");
+    pm.Tags({loot::Tag("Relev")});
+    ml.AddPlugin(pm);
+
+    pm = loot::PluginMetadata("(Blank) - \\1\\.esp");
+    pm.Tags({loot::Tag("Delev")});
+    ml.AddPlugin(pm);
+
+    pm = loot::PluginMetadata("Blank - Plugin.*");
+    pm.Tags({loot::Tag("Names")});
+    ml.AddPlugin(pm);
+
+    pm = ml.FindPlugin(loot::PluginMetadata("Blank - Plugin Dependent.esp"));
+    EXPECT_EQ(boost::container::flat_set<loot::Tag>({
+        loot::Tag("Relev"),
+        loot::Tag("Names"),
+    }), pm.Tags());
+
+    pm = ml.FindPlugin(loot::PluginMetadata("Blank - Blank.esp"));
+    EXPECT_EQ(boost::container::flat_set<loot::Tag>({
+        loot::Tag("Delev"),
+    }), pm.Tags());
+
+    pm = ml.FindPlugin(loot::PluginMetadata("Blank.esm"));
+    EXPECT_TRUE(pm.HasNameOnly());
+}
+
+TEST_F(MetadataList, CollectTagNames_ShouldIncludeTagsWhateverTheirConditions) {
+    loot::MetadataList ml;
+
+    loot::PluginMetadata pm("Blank.esp");
+    pm.Tags({
+        loot::Tag("Relev"),
+        loot::Tag("Delev", false, "file(\"Missing.esp\")"),
+    });
+    ml.AddPlugin(pm);
+
+    pm = loot::PluginMetadata("Blank - Plugin.*");
+    pm.Tags({loot::Tag("Names")});
+    ml.AddPlugin(pm);
+
+    std::set<std::string> tagNames;
+    ml.CollectTagNames(tagNames);
+    EXPECT_EQ(std::set<std::string>({
+        "Delev",
+        "Names",
+        "Relev",
+    }), tagNames);
+}
+
+TEST_F(MetadataList, VisitPlugins_ShouldVisitAcceptedEntriesInNameOrder) {
+    loot::MetadataList ml;
+
+    loot::PluginMetadata pm("Blank.esp");
+    pm.Tags({loot::Tag("Relev")});
+    ml.AddPlugin(pm);
+    ml.AddPlugin(loot::PluginMetadata("Blank.esm"));
+
+    pm = loot::PluginMetadata("Blank - Plugin.*");
+    pm.Tags({loot::Tag("Names")});
+    ml.AddPlugin(pm);
+
+    pm = loot::PluginMetadata("blank - different.esp");
+    pm.Tags({loot::Tag("Delev")});
+    ml.AddPlugin(pm);
+
+    std::vector<std::string> visited;
+    ml.VisitPlugins([](const loot::PluginMetadata& plugin) {
+        return !plugin.Tags().empty();
+    }, [&](const loot::PluginMetadata& plugin) {
+        visited.push_back(plugin.Name());
+    });
+    EXPECT_EQ(std::vector<std::string>({
+        "blank - different.esp",
+        "Blank - Plugin.*",
+        "Blank.esp",
+    }), visited);
+}
+
 TEST_F(MetadataList, AddPlugin) {
     loot::MetadataList ml;
     ASSERT_NO_THROW(ml.Load(metadataPath));
@@ -223,7 +409,7 @@ TEST_F(MetadataList, EvalAllConditions) {
     ASSERT_NO_THROW(ml.Load(metadataPath));
 
     loot::PluginMetadata pm = ml.FindPlugin(loot::PluginMetadata("Blank.esm"));
-    ASSERT_EQ(std::list<loot::Message>({
+    ASSERT_EQ(std::vector<loot::Message>({
         loot::Message(loot::Message::warn, "This is a warning."),
         loot::Message(loot::Message::say, "This message should be removed when evaluating conditions."),
     }), pm.Messages());
@@ -235,7 +421,7 @@ TEST_F(MetadataList, EvalAllConditions) {
     EXPECT_NO_THROW(ml.EvalAllConditions(game, loot::Language::english));
 
     pm = ml.FindPlugin(loot::PluginMetadata("Blank.esm"));
-    EXPECT_EQ(std::list<loot::Message>({
+    EXPECT_EQ(std::vector<loot::Message>({
         loot::Message(loot::Message::warn, "This is a warning."),
     }), pm.Messages());
 
@@ -244,4 +430,110 @@ TEST_F(MetadataList, EvalAllConditions) {
     EXPECT_TRUE(pm.HasNameOnly());
 }
 
+TEST_F(MetadataList, EvalAllConditions_ShouldOnlyEvaluateInstalledPluginsUpFront) {
+    loot::Game game(loot::Game::tes5);
+    game.SetGamePath(dataPath.parent_path());
+    ASSERT_NO_THROW(game.Init(false, localPath));
+    ASSERT_NO_THROW(game.LoadPlugins(true));
+
+    loot::ofstream out(savedMetadataPath);
+    out << "plugins:\n"
+        << "  - name: Blank.esm\n"
+        << "    msg:\n"
+        << "      - type: say\n"
+        << "        content: 'Installed.'\n"
+        << "        condition: 'file(\"Blank.esp\")'\n"
+        << "  - name: NotInstalled.esp\n"
+        << "    msg:\n"
+        << "      - type: say\n"
+        << "        content: 'Not installed.'\n"
+        << "        condition: 'file(\"Blank - Different.esp\")'\n";
+    out.close();
+
+    loot::MetadataList ml;
+    ASSERT_NO_THROW(ml.Load(savedMetadataPath));
+    EXPECT_NO_THROW(ml.EvalAllConditions(game, loot::Language::english));
+
+    EXPECT_TRUE(game.GetCachedCondition("file(\"Blank.esp\")").second);
+    EXPECT_FALSE(game.GetCachedCondition("file(\"Blank - Different.esp\")").second);
+
+    // The entry is evaluated when it is looked up.
+    loot::PluginMetadata pm = ml.FindPlugin(loot::PluginMetadata("NotInstalled.esp"));
+    EXPECT_EQ(std::vector<loot::Message>({
+        loot::Message(loot::Message::say, "Not installed."),
+    }), pm.Messages());
+    EXPECT_TRUE(game.GetCachedCondition("file(\"Blank - Different.esp\")").second);
+}
+
+TEST_F(MetadataList, EvalAllConditions_ShouldEvaluateInstalledPluginsThatAreNotLoaded) {
+    loot::Game game(loot::Game::tes5);
+    game.SetGamePath(dataPath.parent_path());
+    ASSERT_NO_THROW(game.Init(false, localPath));
+    ASSERT_NO_THROW(game.RefreshDataSnapshot());
+
+    loot::ofstream out(savedMetadataPath);
+    out << "plugins:\n"
+        << "  - name: Blank.esm\n"
+        << "    msg:\n"
+        << "      - type: say\n"
+        << "        content: 'Installed.'\n"
+        << "        condition: 'file(\"Blank.esp\")'\n";
+    out.close();
+
+    loot::MetadataList ml;
+    ASSERT_NO_THROW(ml.Load(savedMetadataPath));
+    EXPECT_NO_THROW(ml.EvalAllConditions(game, loot::Language::english));
+
+    EXPECT_TRUE(game.GetCachedCondition("file(\"Blank.esp\")").second);
+}
+
+TEST_F(MetadataList, FindPlugin_ShouldOnlyEvaluateAnEntryOnce) {
+    loot::Game game(loot::Game::tes5);
+    game.SetGamePath(dataPath.parent_path());
+    ASSERT_NO_THROW(game.Init(false, localPath));
+
+    loot::ofstream out(savedMetadataPath);
+    out << "plugins:\n"
+        << "  - name: NotInstalled.esp\n"
+        << "    msg:\n"
+        << "      - type: say\n"
+        << "        content: 'Not installed.'\n"
+        << "        condition: 'file(\"Blank - Different.esp\")'\n";
+    out.close();
+
+    loot::MetadataList ml;
+    ASSERT_NO_THROW(ml.Load(savedMetadataPath));
+    EXPECT_NO_THROW(ml.EvalAllConditions(game, loot::Language::english));
+
+    loot::PluginMetadata pm = ml.FindPlugin(loot::PluginMetadata("NotInstalled.esp"));
+    EXPECT_EQ(1, pm.Messages().size());
+    EXPECT_TRUE(game.GetCachedCondition("file(\"Blank - Different.esp\")").second);
+
+    game.ClearCache();
+    pm = ml.FindPlugin(loot::PluginMetadata("NotInstalled.esp"));
+    EXPECT_EQ(1, pm.Messages().size());
+    EXPECT_FALSE(game.GetCachedCondition("file(\"Blank - Different.esp\")").second);
+}
+
+TEST_F(MetadataList, EvalAllConditions_ShouldNotChangeCopiesOfTheList) {
+    loot::Game game(loot::Game::tes5);
+    game.SetGamePath(dataPath.parent_path());
+    ASSERT_NO_THROW(game.Init(false, localPath));
+    ASSERT_NO_THROW(game.LoadPlugins(true));
+
+    loot::MetadataList ml;
+    ASSERT_NO_THROW(ml.Load(metadataPath));
+
+    loot::MetadataList evaluated(ml);
+    EXPECT_NO_THROW(evaluated.EvalAllConditions(game, loot::Language::english));
+
+    EXPECT_EQ(std::vector<loot::Message>({
+        loot::Message(loot::Message::warn, "This is a warning."),
+    }), evaluated.FindPlugin(loot::PluginMetadata("Blank.esm")).Messages());
+    EXPECT_EQ(std::vector<loot::Message>({
+        loot::Message(loot::Message::warn, "This is a warning."),
+        loot::Message(loot::Message::say, "This message should be removed when evaluating conditions."),
+    }), ml.FindPlugin(loot::PluginMetadata("Blank.esm")).Messages());
+}
+
 #endif
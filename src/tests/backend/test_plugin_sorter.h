@@ -191,4 +191,23 @@ TEST_F(PluginSorter, Sort_HasCycle) {
     EXPECT_ANY_THROW(ps.Sort(game, loot::Language::english, callback));
 }
 
+TEST_F(PluginSorter, Sort_ShouldStopWhenCancelled) {
+    ASSERT_NO_THROW(game.LoadPlugins(false));
+
+    loot::CancellationToken cancellation;
+    cancellation.Cancel();
+
+    loot::PluginSorter ps;
+    try {
+        ps.Sort(game, loot::Language::english, callback, cancellation);
+        FAIL() << "Sorting should have been cancelled.";
+    }
+    catch (loot::error& e) {
+        EXPECT_EQ(loot::error::cancelled, e.code());
+    }
+
+    // A new token should let the sort finish.
+    EXPECT_EQ(11, ps.Sort(game, loot::Language::english, callback).size());
+}
+
 #endif
@@ -28,9 +28,12 @@
 #endif
 
 #include "api/test_api.h"
+#include "backend/game/test_data_directory_snapshot.h"
 #include "backend/game/test_game.h"
+#include "backend/game/test_game_cache.h"
 #include "backend/game/test_game_settings.h"
 #include "backend/game/test_load_order_handler.h"
+#include "backend/game/test_sharded_cache.h"
 #include "backend/helpers/test_git_helper.h"
 #include "backend/helpers/test_helpers.h"
 #include "backend/helpers/test_language.h"